@@ -0,0 +1,113 @@
+#pragma once
+#include "engine.hpp"
+#include <cstdint>
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+namespace Engine {
+// Single square bitboard, empty for squares off the board
+constexpr uint64_t bit(uint8_t index) {
+	if (index >= 64)
+		return 0;
+	return 1ULL << index;
+}
+// Targets of a leaper from every square, generated at compile time
+struct LeaperTable {
+	uint64_t targets[64];
+	constexpr uint64_t operator[](uint8_t index) const {
+		return targets[index];
+	}
+};
+// Every jump by the given file and rank steps that stays on the board, from the squares in the mask
+template <size_t steps>
+constexpr LeaperTable leaper_table(const int8_t (&jumps)[steps][2], uint64_t from = ~0ULL) {
+	LeaperTable table{};
+	for (uint8_t index = 0; index < 64; index++) {
+		if (((from >> index) & 1) == 0)
+			continue;
+		for (const int8_t* jump: jumps) {
+			const int8_t file = 7 - index % 8 + jump[0];
+			const int8_t rank = 7 - index / 8 + jump[1];
+			if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+				table.targets[index] |= 1ULL << (8 * (7 - rank) + (7 - file));
+		}
+	}
+	return table;
+}
+constexpr int8_t   knight_jumps[8][2]     = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int8_t   king_jumps[8][2]       = {{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+constexpr int8_t   pawn_captures[2][2][2] = {{{-1, 1}, {1, 1}}, {{-1, -1}, {1, -1}}}; // indexed by Color
+constexpr int8_t   pawn_pushes[2][1][2]   = {{{0, 1}}, {{0, -1}}};
+constexpr int8_t   pawn_jumps[2][1][2]    = {{{0, 2}}, {{0, -2}}};
+constexpr uint64_t pawn_start_ranks[2]    = {0x00FF000000000000ULL, 0x000000000000FF00ULL};
+inline constexpr LeaperTable knight_table          = leaper_table(knight_jumps);
+inline constexpr LeaperTable king_table            = leaper_table(king_jumps);
+inline constexpr LeaperTable pawn_attack_tables[2] = {leaper_table(pawn_captures[0]), leaper_table(pawn_captures[1])};
+inline constexpr LeaperTable pawn_push_tables[2]   = {leaper_table(pawn_pushes[0]), leaper_table(pawn_pushes[1])};
+// Two squares ahead, only from the starting rank
+inline constexpr LeaperTable pawn_double_push_tables[2] = {leaper_table(pawn_jumps[0], pawn_start_ranks[0]),
+                                                           leaper_table(pawn_jumps[1], pawn_start_ranks[1])};
+constexpr uint16_t table_bits(const LeaperTable& table) {
+	uint16_t bits = 0;
+	for (uint64_t targets: table.targets)
+		bits += __builtin_popcountll(targets);
+	return bits;
+}
+// 63 is a1, 59 is e1, 0 is h8
+static_assert(knight_table[63] == (bit(46) | bit(53)) && knight_table[0] == (bit(10) | bit(17)), "knight corners");
+static_assert(king_table[59] == (bit(58) | bit(60) | bit(50) | bit(51) | bit(52)), "king on e1");
+static_assert(pawn_attack_tables[0][51] == (bit(42) | bit(44)) && pawn_attack_tables[1][11] == (bit(18) | bit(20)),
+              "pawn captures");
+static_assert(pawn_attack_tables[0][55] == bit(46) && pawn_attack_tables[0][48] == bit(41), "pawn captures at the edge");
+static_assert(pawn_double_push_tables[0][51] == bit(35) && pawn_double_push_tables[0][43] == 0, "double pushes");
+static_assert(table_bits(knight_table) == 336 && table_bits(king_table) == 420, "leaper target counts");
+static_assert(table_bits(pawn_attack_tables[0]) == 98 && table_bits(pawn_push_tables[1]) == 56, "pawn target counts");
+// Leaper attacks, shared by move generation and the tablebase generator
+constexpr uint64_t pawn_attacks(uint8_t index, Color color) {
+	return pawn_attack_tables[static_cast<uint8_t>(color)][index];
+}
+constexpr uint64_t knight_attacks(uint8_t index) {
+	return knight_table[index];
+}
+constexpr uint64_t king_attacks(uint8_t index) {
+	return king_table[index];
+}
+// Fancy magic bitboard lookup for one square of a sliding piece.
+// With USE_PEXT the BMI2 pext instruction replaces the multiply and shift.
+struct Magic {
+	uint64_t  mask;
+	uint64_t  magic;
+	uint64_t* attacks;
+	uint8_t   shift;
+	inline uint32_t index(uint64_t occupied) const {
+#ifdef USE_PEXT
+		return static_cast<uint32_t>(_pext_u64(occupied, mask));
+#else
+		return static_cast<uint32_t>(((occupied & mask) * magic) >> shift);
+#endif
+	}
+};
+extern Magic    rook_magics[64];
+extern Magic    bishop_magics[64];
+extern uint64_t between_table[64][64]; // squares strictly between two aligned squares
+extern uint64_t line_table[64][64];    // whole line through two aligned squares
+inline uint64_t rook_attacks(uint8_t index, uint64_t occupied) {
+	const Magic& magic = rook_magics[index];
+	return magic.attacks[magic.index(occupied)];
+}
+inline uint64_t bishop_attacks(uint8_t index, uint64_t occupied) {
+	const Magic& magic = bishop_magics[index];
+	return magic.attacks[magic.index(occupied)];
+}
+inline uint64_t queen_attacks(uint8_t index, uint64_t occupied) {
+	return rook_attacks(index, occupied) | bishop_attacks(index, occupied);
+}
+// Pieces of color attacking the tile, sliders see through the occupancy given
+uint64_t        attackers(const Board& board, uint8_t tile, Color color, uint64_t occupied);
+inline uint64_t between(uint8_t a, uint8_t b) {
+	return between_table[a][b];
+}
+inline uint64_t line(uint8_t a, uint8_t b) {
+	return line_table[a][b];
+}
+} // namespace Engine
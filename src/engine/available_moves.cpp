@@ -1,370 +1,166 @@
+#include "attacks.hpp"
 #include "engine.hpp"
+#include "profile.hpp"
+#include <cassert>
 #include <cstdint>
 #include <cstdio>
 namespace Engine {
-namespace {
-constexpr uint64_t bit(uint8_t index) {
-	if (index >= 64)
-		return 0;
-	return 1ULL << index;
-}
-constexpr bool en_passant(Piece piece, Color color) {
-	return piece_color(piece) == color || piece == Piece::en_passant;
-}
-uint64_t white_pawn_moves(uint8_t index, const Board& board) {
-	uint64_t result = (piece_color(board.get_piece(index - 8)) == Color::none ? bit(index - 8) : 0);
-	if (index >= 48 && index < 56 && result != 0)
-		result |= bit(index - 16);
-	if (index % 8 != 7 && en_passant(board.get_piece(index - 7), Color::black))
-		result |= bit(index - 7);
-	if (index % 8 != 0 && en_passant(board.get_piece(index - 9), Color::black))
-		result |= bit(index - 9);
-	if (index < 16) {
-		for (uint8_t i = 0; i < 8; i++) {
-			if ((result >> i) & 1) {
-				result |= bit(i + 8) | bit(i + 16) | bit(i + 24);
-			}
-		}
-	}
-	return result;
+uint64_t attackers(const Board& board, uint8_t tile, Color color, uint64_t occupied) {
+	const Color    opponent = (color == Color::white ? Color::black : Color::white);
+	const uint64_t queens   = board.pieces(color, PieceType::queen);
+	return (pawn_attacks(tile, opponent) & board.pieces(color, PieceType::pawn))
+	       | (knight_attacks(tile) & board.pieces(color, PieceType::knight))
+	       | (king_attacks(tile) & board.pieces(color, PieceType::king))
+	       | (bishop_attacks(tile, occupied) & (board.pieces(color, PieceType::bishop) | queens))
+	       | (rook_attacks(tile, occupied) & (board.pieces(color, PieceType::rook) | queens));
 }
-uint64_t black_pawn_moves(uint8_t index, const Board& board) {
-	uint64_t result = (piece_color(board.get_piece(index + 8)) == Color::none ? bit(index + 8) : 0);
-	if (index >= 8 && index < 16 && result != 0)
-		result |= bit(index + 16);
-	if (index % 8 != 0 && piece_color(board.get_piece(index - 7)) == Color::white)
-		result |= bit(index + 7);
-	if (index % 8 != 7 && piece_color(board.get_piece(index - 9)) == Color::white)
-		result |= bit(index + 9);
-	if (index >= 48) {
-		for (uint8_t i = 56; i < 64; i++) {
-			if ((result >> i) & 1) {
-				result |= bit(i - 8) | bit(i - 16) | bit(i - 24);
-			}
-		}
-	}
+namespace {
+// Every square attacked by color, sliders see through the occupancy given
+uint64_t attack_map(const Board& board, Color color, uint64_t occupied) {
+	uint64_t result = 0;
+	for (uint64_t pawns = board.pieces(color, PieceType::pawn); pawns != 0; pawns &= pawns - 1)
+		result |= pawn_attacks(lowest_bit(pawns), color);
+	for (uint64_t knights = board.pieces(color, PieceType::knight); knights != 0; knights &= knights - 1)
+		result |= knight_attacks(lowest_bit(knights));
+	const uint64_t queens = board.pieces(color, PieceType::queen);
+	for (uint64_t diagonal = board.pieces(color, PieceType::bishop) | queens; diagonal != 0; diagonal &= diagonal - 1)
+		result |= bishop_attacks(lowest_bit(diagonal), occupied);
+	for (uint64_t orthogonal = board.pieces(color, PieceType::rook) | queens; orthogonal != 0; orthogonal &= orthogonal - 1)
+		result |= rook_attacks(lowest_bit(orthogonal), occupied);
+	for (uint64_t kings = board.pieces(color, PieceType::king); kings != 0; kings &= kings - 1)
+		result |= king_attacks(lowest_bit(kings));
 	return result;
 }
-uint64_t knight_moves(uint8_t index, const Board& board) {
-	uint64_t result =
-	    (index % 8 > 0 ? bit(index - 17) | bit(index + 15) : 0) | (index % 8 < 7 ? bit(index - 15) | bit(index + 17) : 0)
-	    | (index % 8 > 1 ? bit(index - 10) | bit(index + 6) : 0) | (index % 8 < 6 ? bit(index - 6) | bit(index + 10) : 0);
-	const Color color = piece_color(board.get_piece(index));
-	for (uint8_t i = 0; i < 64; i++) {
-		if (((result >> i) & 1ULL) && color == piece_color(board.get_piece(i))) {
-			result &= ~bit(i);
-		}
+// Pieces of color standing alone between the tile and an enemy slider
+uint64_t pinned_pieces(const Board& board, uint8_t tile, Color color) {
+	const Color    opponent = (color == Color::white ? Color::black : Color::white);
+	const uint64_t queens   = board.pieces(opponent, PieceType::queen);
+	const uint64_t snipers =
+	    (bishop_attacks(tile, 0) & (board.pieces(opponent, PieceType::bishop) | queens))
+	    | (rook_attacks(tile, 0) & (board.pieces(opponent, PieceType::rook) | queens));
+	uint64_t result = 0;
+	for (uint64_t candidates = snipers; candidates != 0; candidates &= candidates - 1) {
+		const uint64_t blockers = between(tile, lowest_bit(candidates)) & board.occupied();
+		if (bit_count(blockers) == 1)
+			result |= blockers & board.pieces(color);
 	}
 	return result;
 }
-uint64_t beam_moves(uint8_t index, const Board& board, int8_t dx, int8_t dy) {
-	const Color color  = piece_color(board.get_piece(index));
-	uint64_t    result = 0;
-	uint8_t     file   = dx + index % 8;
-	while (file < 8 && index < 64) {
-		index += 8 * dy + dx;
-		if (piece_color(board.get_piece(index)) == color)
-			return result;
-		result |= bit(index);
-		if (piece_color(board.get_piece(index)) != Color::none)
-			return result;
-		file += dx;
+uint64_t pawn_moves(uint8_t index, const Board& board, Color color) {
+	const uint64_t empty   = ~board.occupied();
+	const uint64_t targets = board.pieces(color == Color::white ? Color::black : Color::white);
+	uint64_t       result  = pawn_push_tables[static_cast<uint8_t>(color)][index] & empty;
+	// The double push needs the square in between empty as well
+	if (result != 0)
+		result |= pawn_double_push_tables[static_cast<uint8_t>(color)][index] & empty;
+	return result | (pawn_attacks(index, color) & targets);
+}
+uint64_t castles(const Board& board, Color color, uint64_t danger) {
+	const uint64_t occupied = board.occupied();
+	uint64_t       result   = 0;
+	if (color == Color::white) {
+		if (board.get_piece(63) == Piece::white_rook_unmoved && (occupied & (bit(60) | bit(61) | bit(62))) == 0
+		    && (danger & (bit(59) | bit(60) | bit(61))) == 0)
+			result |= bit(61);
+		if (board.get_piece(56) == Piece::white_rook_unmoved && (occupied & (bit(57) | bit(58))) == 0
+		    && (danger & (bit(57) | bit(58) | bit(59))) == 0)
+			result |= bit(57);
+		return result;
 	}
-	return result;
-}
-uint64_t bishop_moves(uint8_t index, const Board& board) {
-	return beam_moves(index, board, 1, 1) | beam_moves(index, board, -1, 1) | beam_moves(index, board, 1, -1)
-	       | beam_moves(index, board, -1, -1);
-}
-uint64_t rook_moves(uint8_t index, const Board& board) {
-	return beam_moves(index, board, 1, 0) | beam_moves(index, board, 0, 1) | beam_moves(index, board, -1, 0)
-	       | beam_moves(index, board, 0, -1);
-}
-uint64_t queen_moves(uint8_t index, const Board& board) {
-	return beam_moves(index, board, 1, 0) | beam_moves(index, board, 0, 1) | beam_moves(index, board, -1, 0)
-	       | beam_moves(index, board, 0, -1) | beam_moves(index, board, 1, 1) | beam_moves(index, board, -1, 1)
-	       | beam_moves(index, board, 1, -1) | beam_moves(index, board, -1, -1);
-}
-uint64_t white_king_castles(const Board& board) {
-	uint64_t result = 0;
-	if (piece_color(board.get_piece(60)) == Color::none && piece_color(board.get_piece(61)) == Color::none
-	    && piece_color(board.get_piece(62)) == Color::none && board.get_piece(63) == Piece::white_rook_unmoved)
-		result |= bit(61);
-	if (piece_color(board.get_piece(58)) == Color::none && piece_color(board.get_piece(57)) == Color::none
-	    && board.get_piece(56) == Piece::white_rook_unmoved)
-		result |= bit(57);
-	return result;
-}
-uint64_t black_king_castles(const Board& board) {
-	uint64_t result = 0;
-	if (piece_color(board.get_piece(4)) == Color::none && piece_color(board.get_piece(5)) == Color::none
-	    && piece_color(board.get_piece(6)) == Color::none && board.get_piece(7) == Piece::black_rook_unmoved)
+	if (board.get_piece(7) == Piece::black_rook_unmoved && (occupied & (bit(4) | bit(5) | bit(6))) == 0
+	    && (danger & (bit(3) | bit(4) | bit(5))) == 0)
 		result |= bit(5);
-	if (piece_color(board.get_piece(2)) == Color::none && piece_color(board.get_piece(1)) == Color::none
-	    && board.get_piece(0) == Piece::black_rook_unmoved)
+	if (board.get_piece(0) == Piece::black_rook_unmoved && (occupied & (bit(1) | bit(2))) == 0
+	    && (danger & (bit(1) | bit(2) | bit(3))) == 0)
 		result |= bit(1);
 	return result;
 }
-uint64_t king_moves(uint8_t index, const Board& board) {
-	uint64_t result = (bit(index - 8) | bit(index + 8))
-	                  | (index % 8 > 0 ? bit(index + 9) | bit(index + 1) | bit(index - 7) : 0)
-	                  | (index % 8 < 7 ? bit(index + 7) | bit(index - 1) | bit(index - 9) : 0);
-	const Color color = piece_color(board.get_piece(index));
-	for (uint8_t i = 0; i < 64; i++) {
-		if (((result >> i) & 1ULL) && color == piece_color(board.get_piece(i))) {
-			result &= ~bit(i);
-		}
-	}
-	if (board.get_piece(index) == Piece::white_king && index == 59)
-		result |= white_king_castles(board);
-	else if (board.get_piece(index) == Piece::black_king && index == 3)
-		result |= black_king_castles(board);
-	return result;
-}
-/*
-Piece test_tile(const Board& board, uint8_t tile, uint8_t min_file, uint8_t max_file) {
-	if (tile >= 64 || tile % 8 < min_file || tile % 8 > max_file)
-		return Piece::empty;
-	return board.get_piece(tile);
-}
-uint64_t is_tile_in_danger_from_diagonal(const Board& board, uint8_t tile, Color color, int8_t dx, int8_t dy) {
-  if (tile >= 64)
-    return 0xFFFFFFFFFFFFFFFF;
-  uint64_t result = 0;
-  uint8_t  file   = dx + tile % 8;
-  while (file < 8 && tile < 64) {
-    tile += 8 * dy + dx;
-    result |= bit(tile);
-    Piece piece = board.get_piece(tile);
-    if (piece_color(piece) != Color::none) {
-      if ((color == Color::white && (piece == Piece::black_bishop || piece == Piece::black_queen))
-          || (color == Color::black && (piece == Piece::white_bishop || piece == Piece::white_queen))) {
-        printf("%lX\n", result);
-        exit(1);
-        return result;
-      }
-      return 0xFFFFFFFFFFFFFFFF;
-    }
-    file += dx;
-  }
-  return 0xFFFFFFFFFFFFFFFF;
-}
-uint64_t is_tile_in_danger_from_orthogonal(const Board& board, uint8_t tile, Color color, int8_t dx, int8_t dy) {
-  if (tile >= 64)
-    return 0xFFFFFFFFFFFFFFFF;
-  uint64_t result = 0;
-  uint8_t  file   = dx + tile % 8;
-  while (file < 8 && tile < 64) {
-    tile += 8 * dy + dx;
-    result |= bit(tile);
-    Piece piece = board.get_piece(tile);
-    if (piece_color(piece) != Color::none) {
-      if ((color == Color::white
-           && (piece == Piece::black_rook_moved || piece == Piece::black_rook_unmoved || piece == Piece::black_queen))
-          || (color == Color::black
-              && (piece == Piece::white_rook_moved || piece == Piece::white_rook_unmoved
-                  || piece == Piece::white_queen))) {
-        printf("%lX\n", result);
-        exit(1);
-        return result;
-      }
-      return 0xFFFFFFFFFFFFFFFF;
-    }
-    file += dx;
-  }
-  return 0xFFFFFFFFFFFFFFFF;
-}
-*/
-uint64_t is_tile_in_danger(const Board& board, uint8_t tile, Color color) {
-	/*
-	if (tile >= 64)
-	  return 0xFFFFFFFFFFFFFFFF;
-	uint64_t    result = 0xFFFFFFFFFFFFFFFF;
-	const Piece tile1  = test_tile(board, tile - 17, 1, 7);
-	if ((color == Color::white && tile1 == Piece::black_knight)
-	    || (color == Color::black && tile1 == Piece::white_knight))
-	  result &= bit(tile - 17);
-	if (result == 0)
-	  exit(1);
-	const Piece tile2 = test_tile(board, tile - 15, 0, 6);
-	if ((color == Color::white && tile2 == Piece::black_knight)
-	    || (color == Color::black && tile2 == Piece::white_knight))
-	  result &= bit(tile - 15);
-	if (result == 0)
-	  exit(1);
-	const Piece tile3 = test_tile(board, tile - 10, 2, 7);
-	if ((color == Color::white && tile3 == Piece::black_knight)
-	    || (color == Color::black && tile3 == Piece::white_knight))
-	  result &= bit(tile - 10);
-	if (result == 0)
-	  exit(1);
-	const Piece tile4 = test_tile(board, tile - 9, 1, 7);
-	if ((color == Color::white && (tile4 == Piece::black_pawn || tile4 == Piece::black_king))
-	    || (color == Color::black && tile4 == Piece::white_king))
-	  result &= bit(tile - 9);
-	if (result == 0)
-	  exit(1);
-	const Piece tile5 = test_tile(board, tile - 8, 0, 7);
-	if ((color == Color::white && tile5 == Piece::black_king) || (color == Color::black && tile5 == Piece::white_king))
-	  result &= bit(tile - 8);
-	if (result == 0)
-	  exit(1);
-	const Piece tile6 = test_tile(board, tile - 7, 0, 6);
-	if ((color == Color::white && (tile6 == Piece::black_pawn || tile6 == Piece::black_king))
-	    || (color == Color::black && tile6 == Piece::white_king))
-	  result &= bit(tile - 7);
-	if (result == 0)
-	  exit(1);
-	const Piece tile7 = test_tile(board, tile - 6, 0, 5);
-	if ((color == Color::white && tile7 == Piece::black_knight)
-	    || (color == Color::black && tile7 == Piece::white_knight))
-	  result &= bit(tile - 6);
-	if (result == 0)
-	  exit(1);
-	const Piece tile8 = test_tile(board, tile - 1, 1, 7);
-	if ((color == Color::white && tile8 == Piece::black_king) || (color == Color::black && tile8 == Piece::white_king))
-	  result &= bit(tile - 1);
-	if (result == 0)
-	  exit(1);
-	const Piece tile9 = test_tile(board, tile + 1, 0, 6);
-	if ((color == Color::white && tile9 == Piece::black_king) || (color == Color::black && tile9 == Piece::white_king))
-	  result &= bit(tile + 1);
-	if (result == 0)
-	  exit(1);
-	const Piece tile10 = test_tile(board, tile + 6, 2, 7);
-	if ((color == Color::white && tile10 == Piece::black_knight)
-	    || (color == Color::black && tile10 == Piece::white_knight))
-	  result &= bit(tile + 6);
-	if (result == 0)
-	  exit(1);
-	const Piece tile11 = test_tile(board, tile + 7, 1, 7);
-	if ((color == Color::white && tile11 == Piece::black_king)
-	    || (color == Color::black && (tile11 == Piece::white_pawn || tile11 == Piece::white_king)))
-	  result &= bit(tile + 7);
-	if (result == 0)
-	  exit(1);
-	const Piece tile12 = test_tile(board, tile + 8, 0, 7);
-	if ((color == Color::white && tile12 == Piece::black_king) || (color == Color::black && tile12 == Piece::white_king))
-	  result &= bit(tile + 8);
-	if (result == 0)
-	  exit(1);
-	const Piece tile13 = test_tile(board, tile + 9, 0, 6);
-	if ((color == Color::white && (tile13 == Piece::black_king))
-	    || (color == Color::black && (tile13 == Piece::white_pawn || tile13 == Piece::white_king)))
-	  result &= bit(tile + 9);
-	if (result == 0)
-	  exit(1);
-	const Piece tile14 = test_tile(board, tile + 10, 0, 5);
-	if ((color == Color::white && tile14 == Piece::black_knight)
-	    || (color == Color::black && tile14 == Piece::white_knight))
-	  result &= bit(tile + 10);
-	if (result == 0)
-	  exit(1);
-	const Piece tile15 = test_tile(board, tile + 15, 1, 7);
-	if ((color == Color::white && tile15 == Piece::black_knight)
-	    || (color == Color::black && tile15 == Piece::white_knight))
-	  result &= bit(tile + 15);
-	if (result == 0)
-	  exit(1);
-	const Piece tile16 = test_tile(board, tile + 17, 0, 6);
-	if ((color == Color::white && tile16 == Piece::black_knight)
-	    || (color == Color::black && tile16 == Piece::white_knight))
-	  result &= bit(tile + 17);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_diagonal(board, tile, color, -1, -1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_orthogonal(board, tile, color, 0, -1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_diagonal(board, tile, color, 1, -1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_orthogonal(board, tile, color, 1, 0);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_diagonal(board, tile, color, 1, 1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_orthogonal(board, tile, color, 0, 1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_diagonal(board, tile, color, -1, 1);
-	if (result == 0)
-	  exit(1);
-	result &= is_tile_in_danger_from_orthogonal(board, tile, color, -1, 0);
-	if (result == 0)
-	  exit(1);
-	return result;
-	*/
-	return 0xFFFFFFFFFFFFFFFF;
-}
-void generate_pin_squares(uint64_t (&moves)[64], const Board& board, uint8_t king_index, Color king_color) {
-	uint64_t king_attacks = is_tile_in_danger(board, king_index, king_color);
-	if (king_attacks != 0xFFFFFFFFFFFFFFFF) {
-		for (uint8_t i = 0; i < 64; i++)
-			moves[i] &= king_attacks;
-	}
-	uint64_t& king_moves = moves[king_index];
-	for (uint8_t i = 0; i < 64; i++) {
-		if (((king_moves >> i) & 1) && is_tile_in_danger(board, i, king_color) != 0xFFFFFFFFFFFFFFFF)
-			king_moves &= ~bit(i);
-	}
+// Capturing en passant removes two pawns from one line, so it is verified on the resulting occupancy
+bool en_passant_legal(const Board& board, uint8_t from, uint8_t to, uint8_t king_index, Color color) {
+	const Color    opponent = (color == Color::white ? Color::black : Color::white);
+	const uint64_t captured = (color == Color::white ? bit(to + 8) : bit(to - 8));
+	const uint64_t occupied = (board.occupied() ^ bit(from) ^ captured) | bit(to);
+	return (attackers(board, king_index, opponent, occupied) & ~captured) == 0;
 }
 } // namespace
-AvailableMoves::MoveIterator::MoveIterator(const AvailableMoves& moves, bool is_end) :
-    m_moves(moves), m_piece(is_end ? 64 : 0) {
-	if (!is_end)
-		++(*this);
-}
-void AvailableMoves::MoveIterator::operator++() {
-	do {
-		m_dest++;
-		if (m_dest >= 64) {
-			m_piece++;
-			m_dest = 0;
-		}
-	} while (m_piece < 64 && !m_moves.move_possible(Move(m_piece, m_dest)));
+void AvailableMoves::add(uint8_t from, uint64_t targets) {
+	assert(m_size + bit_count(targets) <= capacity);
+	for (; targets != 0; targets &= targets - 1)
+		m_moves[m_size++] = Move(from, lowest_bit(targets));
+}
+void AvailableMoves::add_promotions(uint8_t from, uint64_t targets) {
+	assert(m_size + 4 * bit_count(targets) <= capacity);
+	for (; targets != 0; targets &= targets - 1) {
+		const uint8_t to  = lowest_bit(targets);
+		m_moves[m_size++] = Move(from, to, PieceType::queen);
+		m_moves[m_size++] = Move(from, to, PieceType::knight);
+		m_moves[m_size++] = Move(from, to, PieceType::rook);
+		m_moves[m_size++] = Move(from, to, PieceType::bishop);
+	}
 }
-AvailableMoves::AvailableMoves(const Board& board, Color player) {
-	uint8_t king_index{255};
-	for (uint8_t i = 0; i < 64; i++) {
-		const Piece piece = board.get_piece(i);
-		if (piece_color(piece) != player) {
-			m_moves[i] = 0;
-			continue;
-		}
-		switch (piece) {
-		case Piece::empty:
-		case Piece::en_passant: m_moves[i] = 0; break;
-		case Piece::white_pawn: m_moves[i] = white_pawn_moves(i, board); break;
-		case Piece::black_pawn: m_moves[i] = black_pawn_moves(i, board); break;
-		case Piece::white_knight:
-		case Piece::black_knight: m_moves[i] = knight_moves(i, board); break;
-		case Piece::white_bishop:
-		case Piece::black_bishop: m_moves[i] = bishop_moves(i, board); break;
-		case Piece::white_rook_unmoved:
-		case Piece::white_rook_moved:
-		case Piece::black_rook_unmoved:
-		case Piece::black_rook_moved: m_moves[i] = rook_moves(i, board); break;
-		case Piece::white_queen:
-		case Piece::black_queen: m_moves[i] = queen_moves(i, board); break;
-		case Piece::white_king:
-		case Piece::black_king:
-			king_index = i;
-			m_moves[i] = king_moves(i, board);
-			break;
-		}
+AvailableMoves::AvailableMoves(const Board& board, Color player, MoveKind kind, uint64_t origins) {
+	PROFILE_SCOPE(available_moves);
+	const uint64_t kings = board.pieces(player, PieceType::king);
+	if (kings == 0)
+		return;
+	const Color    opponent   = (player == Color::white ? Color::black : Color::white);
+	const uint8_t  king_index = lowest_bit(kings);
+	const uint64_t occupied   = board.occupied();
+	const uint64_t own        = board.pieces(player);
+	const uint64_t checkers   = attackers(board, king_index, opponent, occupied);
+	// Destinations of the kind asked for, promotions are tactical whatever they land on
+	const uint64_t targets    = (kind == MoveKind::all        ? ~0ULL
+	                             : kind == MoveKind::tactical ? board.pieces(opponent)
+	                                                          : ~board.pieces(opponent));
+	m_check                   = checkers != 0;
+	if ((kings & origins) != 0) {
+		// The king is removed from the occupancy so it cannot retreat along the ray of a slider checking it
+		const uint64_t danger     = attack_map(board, opponent, occupied ^ kings);
+		uint64_t       king_moves = king_attacks(king_index) & ~own & ~danger & targets;
+		if (checkers == 0 && kind != MoveKind::tactical && king_index == (player == Color::white ? 59 : 3))
+			king_moves |= castles(board, player, danger);
+		add(king_index, king_moves);
 	}
-	if (king_index == 255) {
-		for (uint8_t i = 0; i < 64; i++)
-			m_moves[i] = 0;
+	if (bit_count(checkers) > 1 || (own & ~kings & origins) == 0) {
+		PROFILE_ADD(moves_generated, m_size);
 		return;
 	}
-	generate_pin_squares(m_moves, board, king_index, player);
+	const uint64_t pinned    = pinned_pieces(board, king_index, player);
+	const uint64_t evasions  = (checkers == 0 ? ~0ULL : checkers | between(king_index, lowest_bit(checkers)));
+	const uint64_t last_rank = (player == Color::white ? 0x00000000000000FFULL : 0xFF00000000000000ULL);
+	for (uint64_t pieces = own & ~kings & origins; pieces != 0; pieces &= pieces - 1) {
+		const uint8_t i     = lowest_bit(pieces);
+		uint64_t      moves = 0;
+		switch (piece_type(board.get_piece(i))) {
+		case PieceType::pawn: moves = pawn_moves(i, board, player); break;
+		case PieceType::knight: moves = knight_attacks(i); break;
+		case PieceType::bishop: moves = bishop_attacks(i, occupied); break;
+		case PieceType::rook: moves = rook_attacks(i, occupied); break;
+		case PieceType::queen: moves = queen_attacks(i, occupied); break;
+		case PieceType::king:
+		case PieceType::en_passant:
+		case PieceType::empty: break;
+		}
+		moves &= ~own & evasions;
+		if ((pinned >> i) & 1)
+			moves &= line(king_index, i);
+		if (piece_type(board.get_piece(i)) == PieceType::pawn) {
+			const uint64_t marker = pawn_attacks(i, player) & board.pieces(PieceType::en_passant);
+			if (kind != MoveKind::quiet && marker != 0 && en_passant_legal(board, i, lowest_bit(marker), king_index, player))
+				add(i, marker);
+			add(i, moves & ~last_rank & targets);
+			if (kind != MoveKind::quiet)
+				add_promotions(i, moves & last_rank);
+		} else
+			add(i, moves & targets);
+	}
+	PROFILE_ADD(moves_generated, m_size);
 }
 bool AvailableMoves::move_possible(Move move) const {
-	return m_moves[move.from()] & (1ULL << move.to());
+	for (Move available: *this) {
+		if (available == move)
+			return true;
+	}
+	return false;
 }
 } // namespace Engine
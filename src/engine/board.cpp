@@ -1,4 +1,6 @@
 #include "engine.hpp"
+#include "profile.hpp"
+#include "util.hpp"
 #include <cstring>
 constexpr uint32_t initial_position[8] = {
     0xABCDFCBA, // rank 8
@@ -11,17 +13,91 @@ constexpr uint32_t initial_position[8] = {
     0x23457432, // rank 1
 };
 namespace Engine {
+namespace {
+struct ZobristKeys {
+	uint64_t pieces[16][64]; // indexed by the nibble, empty squares have no key
+	uint64_t side;
+};
+constexpr ZobristKeys generate_zobrist_keys() {
+	ZobristKeys keys{};
+	uint64_t    state = 0x43505043686573ULL;
+	for (uint8_t piece = 1; piece < 16; piece++) {
+		for (uint8_t index = 0; index < 64; index++)
+			keys.pieces[piece][index] = splitmix64(state);
+	}
+	keys.side = splitmix64(state);
+	return keys;
+}
+constexpr ZobristKeys zobrist = generate_zobrist_keys();
+constexpr uint8_t corners[4]      = {0, 7, 56, 63};
+constexpr Piece   corner_rooks[4] = {Piece::black_rook_unmoved, Piece::black_rook_unmoved, Piece::white_rook_unmoved,
+                                     Piece::white_rook_unmoved};
+uint8_t castling_rights(const Board& board) {
+	uint8_t result = 0;
+	for (uint8_t i = 0; i < 4; i++) {
+		if (board.get_piece(corners[i]) == corner_rooks[i])
+			result |= 1 << i;
+	}
+	return result;
+}
+// Piece a pawn of color turns into, promoted rooks have already moved
+Piece promoted(PieceType type, Color color) {
+	constexpr Piece white_pieces[5] = {Piece::empty, Piece::white_knight, Piece::white_bishop, Piece::white_rook_moved,
+	                                   Piece::white_queen};
+	const Piece     piece           = white_pieces[static_cast<uint8_t>(type)];
+	return color == Color::white ? piece : static_cast<Piece>(static_cast<uint8_t>(piece) | 0x08);
+}
+} // namespace
 Board::Board() {
 	std::memcpy(m_data, initial_position, 32);
+	sync_bitboards(Color::white);
 }
 void Board::set_piece(uint8_t index, Piece piece) {
-	uint32_t&     row   = m_data[index / 8];
-	const uint8_t shift = (index % 8) * 4;
+	uint32_t&      row   = m_data[index / 8];
+	const uint8_t  shift = (index % 8) * 4;
+	const Piece    old   = static_cast<Piece>((row >> shift) & 0x0F);
+	const uint64_t mask  = 1ULL << index;
+	m_types[static_cast<uint8_t>(piece_type(old))] &= ~mask;
+	m_colors[static_cast<uint8_t>(piece_color(old))] &= ~mask;
+	m_types[static_cast<uint8_t>(piece_type(piece))] |= mask;
+	m_colors[static_cast<uint8_t>(piece_color(piece))] |= mask;
+	m_hash ^= zobrist.pieces[static_cast<uint8_t>(old)][index] ^ zobrist.pieces[static_cast<uint8_t>(piece)][index];
 	row &= ~(0x0F << shift);
 	row |= (static_cast<uint32_t>(piece) << shift);
 }
-void Board::make_move(Move move) {
-	Piece moved = get_piece(move.from());
+void Board::sync_bitboards(Color turn) {
+	PackedBitboards bitboards;
+	unpack_board(m_data, bitboards);
+	std::memcpy(m_types, bitboards.types, sizeof(m_types));
+	std::memcpy(m_colors, bitboards.colors, sizeof(m_colors));
+	// Empty squares have no key
+	m_hash = 0;
+	for (uint64_t keyed = ~m_types[static_cast<uint8_t>(PieceType::empty)]; keyed != 0; keyed &= keyed - 1) {
+		const uint8_t i = lowest_bit(keyed);
+		m_hash ^= zobrist.pieces[static_cast<uint8_t>(get_piece(i))][i];
+	}
+	if (turn == Color::black)
+		m_hash ^= zobrist.side;
+}
+void Board::set_data(const uint32_t* data, Color turn) {
+	std::memcpy(m_data, data, sizeof(m_data));
+	sync_bitboards(turn);
+}
+Undo Board::make_move(Move move) {
+	PROFILE_SCOPE(make_move);
+	Piece          moved   = get_piece(move.from());
+	const uint64_t markers = pieces(PieceType::en_passant);
+	Undo           undo;
+	undo.moved      = moved;
+	undo.captured   = get_piece(move.to());
+	undo.en_passant = (markers != 0 ? lowest_bit(markers) : 64);
+	undo.castling   = castling_rights(*this);
+	m_hash ^= zobrist.side;
+	// Pawns only ever step onto a marker by capturing diagonally
+	const bool captures_en_passant = undo.captured == Piece::en_passant;
+	// Markers only live for a single ply, the one placed below belongs to this move
+	if (markers != 0)
+		set_piece(undo.en_passant, Piece::empty);
 	switch (moved) {
 	case Piece::empty:
 	case Piece::en_passant:
@@ -36,42 +112,28 @@ void Board::make_move(Move move) {
 	case Piece::white_rook_unmoved: moved = Piece::white_rook_moved; break;
 	case Piece::black_rook_unmoved: moved = Piece::black_rook_moved; break;
 	case Piece::white_pawn:
+		if (captures_en_passant) {
+			set_piece(move.to() + 8, Piece::empty);
+			break;
+		}
 		if (move.from() >= 48 && move.to() < 40) {
 			set_piece(move.from() - 8, Piece::en_passant);
 			break;
 		}
-		if (move.from() < 16) {
-			for (uint8_t i = 16; i < 24; i++) {
-				if (get_piece(i) == Piece::en_passant)
-					set_piece(i, Piece::empty);
-			}
-			set_piece(move.from(), Piece::empty);
-			switch (move.to() / 8) {
-			default: set_piece(move.to(), Piece::white_queen); return;
-			case 1: set_piece(move.to() - 8, Piece::white_knight); return;
-			case 2: set_piece(move.to() - 16, Piece::white_rook_moved); return;
-			case 3: set_piece(move.to() - 24, Piece::white_bishop); return;
-			}
-		}
+		if (move.is_promotion())
+			moved = promoted(move.promotion(), Color::white);
 		break;
 	case Piece::black_pawn:
+		if (captures_en_passant) {
+			set_piece(move.to() - 8, Piece::empty);
+			break;
+		}
 		if (move.from() < 16 && move.to() >= 24) {
 			set_piece(move.from() + 8, Piece::en_passant);
 			break;
 		}
-		if (move.from() >= 48) {
-			for (uint8_t i = 40; i < 48; i++) {
-				if (get_piece(i) == Piece::en_passant)
-					set_piece(i, Piece::empty);
-			}
-			set_piece(move.from(), Piece::empty);
-			switch (move.to() / 8) {
-			default: set_piece(move.to(), Piece::white_queen); return;
-			case 6: set_piece(move.to() + 8, Piece::white_knight); return;
-			case 5: set_piece(move.to() + 16, Piece::white_rook_moved); return;
-			case 4: set_piece(move.to() + 24, Piece::white_bishop); return;
-			}
-		}
+		if (move.is_promotion())
+			moved = promoted(move.promotion(), Color::black);
 		break;
 	case Piece::white_king:
 		if (move.from() == 59) {
@@ -118,15 +180,54 @@ void Board::make_move(Move move) {
 			set_piece(7, Piece::black_rook_moved);
 		break;
 	}
-	for (uint8_t i = 16; i < 24; i++) {
-		if (get_piece(i) == Piece::en_passant)
-			set_piece(i, Piece::empty);
-	}
-	for (uint8_t i = 40; i < 48; i++) {
-		if (get_piece(i) == Piece::en_passant)
-			set_piece(i, Piece::empty);
-	}
 	set_piece(move.to(), moved);
 	set_piece(move.from(), Piece::empty);
+	return undo;
+}
+void Board::unmake_move(Move move, const Undo& undo) {
+	PROFILE_SCOPE(unmake_move);
+	const uint8_t from = move.from();
+	const uint8_t to   = move.to();
+	m_hash ^= zobrist.side;
+	for (uint64_t markers = pieces(PieceType::en_passant); markers != 0; markers &= markers - 1)
+		set_piece(lowest_bit(markers), Piece::empty);
+	set_piece(to, undo.captured);
+	set_piece(from, undo.moved);
+	switch (undo.moved) {
+	case Piece::white_pawn:
+		if (undo.captured == Piece::en_passant)
+			set_piece(to + 8, Piece::black_pawn);
+		break;
+	case Piece::black_pawn:
+		if (undo.captured == Piece::en_passant)
+			set_piece(to - 8, Piece::white_pawn);
+		break;
+	case Piece::white_king:
+		if (from == 59 && to == 61) {
+			set_piece(60, Piece::empty);
+			set_piece(63, Piece::white_rook_moved);
+		} else if (from == 59 && to == 57) {
+			set_piece(58, Piece::empty);
+			set_piece(56, Piece::white_rook_moved);
+		}
+		break;
+	case Piece::black_king:
+		if (from == 3 && to == 5) {
+			set_piece(4, Piece::empty);
+			set_piece(7, Piece::black_rook_moved);
+		} else if (from == 3 && to == 1) {
+			set_piece(2, Piece::empty);
+			set_piece(0, Piece::black_rook_moved);
+		}
+		break;
+	default: break;
+	}
+	// Corner rooks the move marked as moved, the rook moved by castling included
+	for (uint8_t i = 0; i < 4; i++) {
+		if ((undo.castling >> i) & 1)
+			set_piece(corners[i], corner_rooks[i]);
+	}
+	if (undo.en_passant < 64)
+		set_piece(undo.en_passant, Piece::en_passant);
 }
 } // namespace Engine
@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -25,24 +27,56 @@ enum class Piece : uint8_t {
 	black_rook_moved   = 0x0E,
 	black_king         = 0x0F,
 };
+enum class PieceType : uint8_t { pawn, knight, bishop, rook, queen, king, en_passant, empty };
 constexpr Color piece_color(Piece piece) {
 	if ((static_cast<uint8_t>(piece) & 0x07) == 0x00)
 		return Color::none;
 	return (static_cast<uint8_t>(piece) & 0x08) == 0 ? Color::white : Color::black;
 }
+constexpr PieceType piece_type(Piece piece) {
+	constexpr PieceType types[16] = {
+	    PieceType::empty,      PieceType::pawn, PieceType::rook, PieceType::knight,
+	    PieceType::bishop,     PieceType::queen, PieceType::rook, PieceType::king,
+	    PieceType::en_passant, PieceType::pawn, PieceType::rook, PieceType::knight,
+	    PieceType::bishop,     PieceType::queen, PieceType::rook, PieceType::king,
+	};
+	return types[static_cast<uint8_t>(piece)];
+}
+inline uint8_t lowest_bit(uint64_t bitboard) {
+	return __builtin_ctzll(bitboard);
+}
+inline uint8_t bit_count(uint64_t bitboard) {
+	return __builtin_popcountll(bitboard);
+}
 class Move;
 class AvailableMoves;
+// What make_move overwrites and unmake_move cannot rebuild from the move itself
+struct Undo {
+	Piece   moved;      // piece that stood on the origin, keeps unmoved rooks and promoted pawns
+	Piece   captured;   // piece that stood on the destination, may be an en_passant marker
+	uint8_t en_passant; // marker square before the move, 64 when there was none
+	uint8_t castling;   // unmoved state of the corner rooks on squares 0, 7, 56 and 63
+};
 class Board {
 	uint32_t m_data[8];
+	// Occupancy bitboards kept in sync with m_data, bit i is square i
+	uint64_t m_types[8];  // indexed by PieceType, includes en_passant and empty squares
+	uint64_t m_colors[3]; // indexed by Color, none holds empty and en_passant squares
+	// Zobrist key of the nibbles, so unmoved rooks and en_passant markers key castling and en passant,
+	// toggled by every move to cover the side to move
+	uint64_t m_hash;
 
 public:
 	Board();
-	Board(const Board&) = delete;
+	explicit Board(const Board&) = default;
 
 private:
-	void set_piece(uint8_t index, Piece piece);
+	// Rebuilds the bitboards and the hash from m_data
+	void sync_bitboards(Color turn);
 
 public:
+	// Places the piece with the bitboards and the hash updated, the board is not checked for legality
+	void set_piece(uint8_t index, Piece piece);
 	inline Piece get_piece(uint8_t index) const {
 		return static_cast<Piece>((m_data[index / 8] >> ((index % 8) * 4)) & 0x0F);
 	}
@@ -50,65 +84,223 @@ public:
 		const uint8_t shift = (7 - file) * 4;
 		return static_cast<Piece>((m_data[7 - rank] >> shift) & 0x0F);
 	}
-	void make_move(Move move);
+	inline uint64_t pieces(Color color) const {
+		return m_colors[static_cast<uint8_t>(color)];
+	}
+	inline uint64_t pieces(PieceType type) const {
+		return m_types[static_cast<uint8_t>(type)];
+	}
+	inline uint64_t pieces(Color color, PieceType type) const {
+		return m_colors[static_cast<uint8_t>(color)] & m_types[static_cast<uint8_t>(type)];
+	}
+	inline uint64_t occupied() const {
+		return m_colors[static_cast<uint8_t>(Color::white)] | m_colors[static_cast<uint8_t>(Color::black)];
+	}
+	inline uint64_t hash() const {
+		return m_hash;
+	}
+	Undo make_move(Move move);
+	void unmake_move(Move move, const Undo& undo);
+	// The nibbles of all 64 squares, enough to rebuild the board
+	inline const uint32_t* data() const {
+		return m_data;
+	}
+	void set_data(const uint32_t* data, Color turn);
+	// Loads the first four fields of a position in Forsyth-Edwards notation, returns false and keeps the board and
+	// turn as they were if they are malformed or the material could not come from a game, rest is set to the text
+	// after them
+	bool set_fen(const char* fen, Color& turn, const char** rest = nullptr);
+	// Writes the first four fields of the position with a terminator, returns the end of the text
+	char* get_fen(Color turn, char* fen) const;
+};
+// Kernels over the packed nibbles of Board::data(), vectorised with AVX2 on processors that have it. The batched
+// forms read count boards, each stride bytes after the previous one, so boards inside larger records are
+// scanned in place.
+struct PackedBitboards {
+	uint64_t types[8];  // indexed by PieceType, includes en_passant and empty squares
+	uint64_t colors[3]; // indexed by Color, none holds empty and en_passant squares
+};
+struct PieceCounts {
+	uint8_t pieces[16]; // squares holding each Piece, empty ones included
 };
+void unpack_board(const uint32_t* data, PackedBitboards& bitboards);
+void unpack_boards(const uint32_t* data, size_t stride, size_t count, PackedBitboards* bitboards);
+void count_pieces(const uint32_t* data, PieceCounts& counts);
+void count_pieces(const uint32_t* data, size_t stride, size_t count, PieceCounts* counts);
+bool same_board(const uint32_t* data, const uint32_t* other);
+// Turns the AVX2 kernels off or back on where the processor has them, returns whether they are now in use
+bool use_avx2(bool enabled);
+// Buffer size that holds any FEN with its counters and terminator
+constexpr size_t fen_size = 100;
+// From, to and promotion packed into 16 bits, 0 is the null move since no move stays on its square
 class Move {
-	uint8_t m_from{255}, m_to{255};
+	uint16_t m_data; // from in bits 0-5, to in bits 6-11, promotion PieceType in bits 12-15 and 0 for none
 
 public:
-	inline Move(uint8_t from, uint8_t to) : m_from(from), m_to(to) {}
-	inline Move(const Move& move) : m_from(move.m_from), m_to(move.m_to) {}
+	// Left uninitialised so move lists cost nothing to construct, Move{} is the null move
+	Move() = default;
+	inline Move(uint8_t from, uint8_t to, PieceType promotion = PieceType::empty) :
+	    m_data(from | to << 6 | (promotion == PieceType::empty ? 0 : static_cast<uint8_t>(promotion)) << 12) {}
+	static inline Move from_data(uint16_t data) {
+		Move move;
+		move.m_data = data;
+		return move;
+	}
 
 public:
 	inline uint8_t from() const {
-		return m_from;
+		return m_data & 0x3F;
 	}
 	inline uint8_t to() const {
-		return m_to;
+		return (m_data >> 6) & 0x3F;
+	}
+	inline uint16_t data() const {
+		return m_data;
+	}
+	inline bool is_promotion() const {
+		return (m_data >> 12) != 0;
+	}
+	inline PieceType promotion() const {
+		return is_promotion() ? static_cast<PieceType>(m_data >> 12) : PieceType::empty;
 	}
-	bool is_capture(const Board& board);
+	inline bool operator==(const Move& move) const {
+		return m_data == move.m_data;
+	}
+	inline bool operator!=(const Move& move) const {
+		return !(*this == move);
+	}
+	bool is_capture(const Board& board) const;
 };
+// Tactical moves are captures, en passant and every promotion, quiet moves are the others including castling
+enum class MoveKind : uint8_t { all, tactical, quiet };
+// Legal moves of one side in a fixed capacity list, no position has more than 218
 class AvailableMoves {
-	uint64_t m_moves[64];
-	class MoveIterator {
-		const AvailableMoves& m_moves;
-		uint8_t               m_piece{0};
-		uint8_t               m_dest{0};
-
-	public:
-		MoveIterator(const AvailableMoves& moves, bool is_end);
-		void operator++();
-		Move operator*() {
-			return Move(m_piece, m_dest);
-		}
-		bool operator!=(const MoveIterator& iterator) {
-			return m_piece != iterator.m_piece || m_dest != iterator.m_dest;
-		}
-	};
+	// Enough as long as boards of impossible material are kept out, Board::set_fen rejects them and only debug
+	// builds assert it
+	static constexpr uint16_t capacity = 256;
+	Move                      m_moves[capacity];
+	uint16_t                  m_size{0};
+	bool                      m_check{false};
 
 public:
-	AvailableMoves(const Board& board, Color player);
-	inline MoveIterator begin() const {
-		return MoveIterator(*this, false);
+	// Only moves of the kind from the origin squares are generated, in_check holds either way
+	AvailableMoves(const Board& board, Color player, MoveKind kind = MoveKind::all, uint64_t origins = ~0ULL);
+
+private:
+	void add(uint8_t from, uint64_t targets);
+	// Every target is pushed four times, once per promotion piece
+	void add_promotions(uint8_t from, uint64_t targets);
+
+public:
+	inline const Move* begin() const {
+		return m_moves;
+	}
+	inline const Move* end() const {
+		return m_moves + m_size;
 	}
-	MoveIterator end() const {
-		return MoveIterator(*this, true);
+	bool            move_possible(Move move) const;
+	inline uint16_t count() const {
+		return m_size;
 	}
+	inline bool in_check() const {
+		return m_check;
+	}
+};
+// Fixed size hash table shared by search threads without locks. Every slot stores its key XORed with its
+// data, a slot torn by concurrent writers fails the key check and reads as a miss.
+class TranspositionTable {
+public:
+	enum class Bound : uint8_t { none, upper, lower, exact };
+	struct Slot;
+	struct Entry {
+		uint16_t move; // Move::data(), 0 when there is none
+		int16_t  score;
+		uint8_t  depth;
+		Bound    bound;
+	};
+
+private:
+	Slot*   m_slots{nullptr};
+	size_t  m_buckets{0};
+	uint8_t m_generation{0};
+
+public:
+	explicit TranspositionTable(size_t megabytes);
+	TranspositionTable(const TranspositionTable&) = delete;
+	~TranspositionTable();
 
 public:
-	bool move_possible(Move move) const;
+	// Returns false and keeps the current table if the memory cannot be allocated
+	bool     resize(size_t megabytes);
+	void     clear();
+	void     new_search();
+	bool     probe(uint64_t hash, Entry& entry) const;
+	void     store(uint64_t hash, const Entry& entry);
+	uint16_t permille_full() const;
 };
+// One line of an EPD file, the operations stay in the mapped file
+struct EpdPosition {
+	uint32_t board[8];   // nibbles as in Board::data()
+	uint64_t operations; // offset of the operations in the file
+	uint16_t length;     // length of the operations
+	Color    turn;
+};
+// Positions of an EPD file, parsed in parallel from a read only mapping that stays open for the operations
+class EpdFile {
+	const char*              m_text{nullptr};
+	size_t                   m_size{0};
+	std::vector<EpdPosition> m_positions{};
+	size_t                   m_rejected{0};
+
+public:
+	EpdFile() {}
+	EpdFile(const EpdFile&) = delete;
+	~EpdFile();
+
+public:
+	// Returns false if the file cannot be mapped, malformed lines are skipped and counted
+	bool open(const char* path, uint8_t threads);
+	void close();
+	inline size_t size() const {
+		return m_positions.size();
+	}
+	inline size_t rejected() const {
+		return m_rejected;
+	}
+	inline const EpdPosition& operator[](size_t index) const {
+		return m_positions[index];
+	}
+	inline void get_board(size_t index, Board& board) const {
+		board.set_data(m_positions[index].board, m_positions[index].turn);
+	}
+	// Operations of the position, such as `bm Nf3; id "1";`, the text is not terminated
+	inline const char* operations(size_t index) const {
+		return m_text + m_positions[index].operations;
+	}
+};
+class Game;
 class Player {
 public:
 	virtual inline ~Player() {}
-	virtual Move get_move(const AvailableMoves& available) = 0;
+	virtual Move get_move(const Game& game, const AvailableMoves& available) = 0;
+	// Called before the player starts another game, drops what it learned about the last one
+	virtual inline void new_game() {}
 };
+enum class Termination : uint8_t { none, checkmate, stalemate, fifty_moves, repetition, insufficient_material };
+enum class GameResult : uint8_t { unknown, white_wins, black_wins, draw };
+class PgnRecord;
 class Game {
-	Board    m_board{};
-	Color    m_turn{Color::white};
-	uint8_t  m_50_move_timer{0};
-	uint16_t m_turn_number{0};
-	Player * m_white{nullptr}, *m_black{nullptr};
+	Board       m_board{};
+	Color       m_turn{Color::white};
+	uint8_t     m_50_move_timer{0};
+	uint16_t    m_turn_number{0};
+	Termination m_termination{Termination::none};
+	Move        m_last_move{};
+	Player *    m_white{nullptr}, *m_black{nullptr};
+	PgnRecord*  m_record{nullptr};
+	// Hashes of the positions since the last capture or pawn move, the current one last, no earlier position
+	// can repeat
+	std::vector<uint64_t> m_history{};
 
 public:
 	Game(Player* white, Player* black);
@@ -124,7 +316,34 @@ public:
 	inline Color get_player() const {
 		return m_turn;
 	}
+	inline uint16_t get_turn_number() const {
+		return m_turn_number;
+	}
+	inline Termination get_termination() const {
+		return m_termination;
+	}
+	// Move{} before the first move
+	inline Move get_last_move() const {
+		return m_last_move;
+	}
+	inline const std::vector<uint64_t>& get_history() const {
+		return m_history;
+	}
+	// Color::none for draws and for games still running
+	Color get_winner() const;
+	// GameResult::unknown while the game is running
+	GameResult get_result() const;
+	// Every move played from now on is appended to the record, nullptr stops recording
+	void record(PgnRecord* record);
+	// Finds the game over when the side to move has no move left or a draw rule applies, returns whether it is
+	bool check_termination(const AvailableMoves& available);
+	// Plays a legal move of the side to move without asking the players, for callers that drive the game
+	void play(Move move);
+	// Asks the player to move unless check_termination finds the game over
 	void advance_turn();
+	// Full FEN including the 50-move counter and the move number, the counters may be left out
+	bool  set_fen(const char* fen);
+	char* get_fen(char* fen) const;
 };
 class TerminalPlayer : public Player {
 public:
@@ -135,35 +354,335 @@ public:
 		uint8_t rank = getchar();
 		return 8 * ('8' - rank) + ('H' - file);
 	}
-	inline Move get_move(const AvailableMoves& available) override {
+	inline Move get_move(const Game& game, const AvailableMoves& available) override {
 		while (true) {
-			Move result = Move(get_tile(), get_tile());
+			const uint8_t from = get_tile();
+			const uint8_t to   = get_tile();
 			while (getchar() != '\n')
 				;
-			if (available.move_possible(result))
-				return result;
+			// Promotions are listed queen first
+			for (Move move: available) {
+				if (move.from() == from && move.to() == to)
+					return move;
+			}
 		}
 	}
 };
-inline void exit(int code) {
-	::exit(code);
-}
+// Plays uniformly random moves from its own splitmix64 sequence, so games on different threads share no state
 class RandomPlayer : public Player {
+	uint64_t m_state;
+
 public:
-	inline RandomPlayer() {
-		srand(time(NULL));
-	}
+	inline RandomPlayer() : m_state(time(NULL)) {}
+	inline explicit RandomPlayer(uint64_t seed) : m_state(seed) {}
 	inline ~RandomPlayer() {}
-	inline Move get_move(const AvailableMoves& available) override {
-		std::vector<Move> moves{};
-		for (Move move: available) {
-			moves.push_back(move);
-		}
-		if (moves.size() == 0)
-			exit(1);
-		while (getchar() != '\n')
-			;
-		return moves[rand() % moves.size()];
+	Move get_move(const Game& game, const AvailableMoves& available) override;
+};
+// Static evaluation in centipawns from the point of view of color
+int16_t evaluate(const Board& board, Color color);
+// Win, draw or loss of the side to move as a tablebase stores it
+struct TablebaseEntry {
+	int8_t  wdl;   // 1 win, 0 draw, -1 loss
+	uint8_t plies; // to mate with best play, 0 for draws
+};
+constexpr uint8_t max_tablebase_pieces = 5;
+// Endgame tablebases solved by retrograde analysis, each table is a bit-packed file probed in place through
+// a read only mapping. Castling rights are not covered, en passant cannot occur since only one side has pawns.
+class Tablebases {
+	struct Table;
+	std::vector<Table*> m_tables{};
+	uint8_t             m_pieces{0};
+
+public:
+	Tablebases() {}
+	Tablebases(const Tablebases&) = delete;
+	~Tablebases();
+
+public:
+	// Maps every .tb file of the directory, returns false if the directory cannot be read
+	bool open(const char* directory);
+	// Maps one table, returns false if it cannot be mapped or is not a table
+	bool add(const char* path);
+	void close();
+	// Most pieces on the board of any table, 0 without tables
+	inline uint8_t pieces() const {
+		return m_pieces;
+	}
+	inline size_t size() const {
+		return m_tables.size();
+	}
+	// False when no table holds the position
+	bool probe(const Board& board, Color turn, TablebaseEntry& entry) const;
+	// Solves material such as "KQvK" on threads threads and writes it to the directory as KQvK.tb, the tables
+	// captures and promotions lead to are solved first unless they are open already. Returns false for
+	// malformed material, sets with pawns on both sides or when a file cannot be written.
+	bool generate(const char* material, const char* directory, uint8_t threads);
+};
+struct SearchLimits {
+	uint8_t                      depth{64};
+	uint64_t                     nodes{0};        // 0 for no limit
+	uint32_t                     milliseconds{0}; // 0 for no limit
+	uint8_t                      threads{1};
+	const std::atomic<bool>*     stop{nullptr};   // set from outside to end the search early
+	const std::atomic<bool>*     ponder{nullptr}; // the time limit is ignored while it is set and counts from its clearing
+	const Tablebases*            tablebases{nullptr};
+	// Hashes of the game since the last capture or pawn move, the root last, as Game keeps them, so the search sees
+	// repetitions of positions played before the root
+	const std::vector<uint64_t>* history{nullptr};
+};
+struct SearchInfo {
+	Move                  move{};
+	int16_t               score{0}; // centipawns, mates are reported as search_mate minus the distance in plies
+	uint8_t               depth{0};
+	uint64_t              nodes{0}; // summed over all threads
+	uint32_t              milliseconds{0};
+	std::vector<uint64_t> thread_nodes{};
+};
+constexpr int16_t search_mate = 32000;
+// Mates are scored within this many plies of search_mate: the search depth plus a tablebase distance to mate
+constexpr int16_t mate_window = 384;
+// Told about every iteration the main search thread completes, called from that thread
+class SearchListener {
+public:
+	virtual inline ~SearchListener() {}
+	virtual void iteration(const SearchInfo& info) = 0;
+};
+// Principal variation alpha-beta with iterative deepening over limits.threads threads sharing the table,
+// the board is restored before returning
+SearchInfo search(Board& board, Color color, TranspositionTable& table, const SearchLimits& limits,
+                  SearchListener* listener = nullptr);
+class SearchPlayer : public Player {
+	TranspositionTable m_table;
+	SearchLimits       m_limits;
+
+public:
+	SearchPlayer(const SearchLimits& limits, size_t hash_megabytes);
+	Move get_move(const Game& game, const AvailableMoves& available) override;
+	void new_game() override;
+};
+enum class PlayerType : uint8_t { random, search };
+struct SelfPlaySettings {
+	uint32_t     games{1};
+	uint8_t      threads{1}; // games played at once
+	PlayerType   white{PlayerType::random};
+	PlayerType   black{PlayerType::random};
+	uint64_t     seed{0};         // game i seeds its random moves with seed + i
+	uint8_t      random_plies{0}; // opening plies played at random, so games between searches differ
+	uint16_t     max_plies{500};  // longer games are adjudicated as draws
+	SearchLimits limits{};        // for search players
+	size_t       hash_megabytes{16};
+	const char*  pgn{nullptr};        // file the games are written to, nullptr to not keep them
+	const char*  book{nullptr};       // Polyglot book both sides play from after the random plies
+	const char*  tablebases{nullptr}; // directory of tables that adjudicate games and serve search players
+	const char*  records{nullptr};    // binary record file every position played is written to
+};
+struct SelfPlayReport {
+	uint32_t games{0};
+	uint64_t plies{0};
+	uint32_t white_wins{0};
+	uint32_t black_wins{0};
+	uint32_t draws{0};
+	uint32_t terminations[6]{}; // indexed by Termination, none counts the games stopped at the ply limit
+	uint32_t tablebase{0};      // games adjudicated by the tablebases
+	uint32_t milliseconds{0};
+};
+// Plays settings.games games without rendering on a pool of settings.threads threads
+SelfPlayReport self_play(const SelfPlaySettings& settings);
+// Standard algebraic notation of a legal move with check and mate marks, returns the end of the terminated text
+char* write_san(const Board& board, Color turn, Move move, char* san);
+// The legal move written in SAN, Move{} when no move or more than one matches
+Move parse_san(const Board& board, const AvailableMoves& available, const char* san, size_t length);
+// Movetext of a game being played, kept until the game is written
+class PgnRecord {
+	char              m_fen[fen_size]{}; // start position, empty for the initial one
+	uint16_t          m_first_ply{0};
+	uint16_t          m_plies{0};
+	std::vector<char> m_moves{};
+
+public:
+	void start(const Game& game);
+	void add(const Board& board, Color turn, Move move);
+	inline const char* fen() const {
+		return m_fen;
+	}
+	inline uint16_t first_ply() const {
+		return m_first_ply;
+	}
+	inline uint16_t plies() const {
+		return m_plies;
+	}
+	// SAN of every move separated by single spaces, not terminated
+	inline const std::vector<char>& moves() const {
+		return m_moves;
+	}
+};
+struct PgnTags {
+	const char* event{"?"};
+	const char* white{"?"};
+	const char* black{"?"};
+	uint32_t    round{0}; // 0 writes "?"
+};
+// Appends finished games to a file through one buffer, safe to share between threads
+class PgnWriter {
+	struct State;
+	State* m_state{nullptr};
+
+public:
+	PgnWriter() {}
+	PgnWriter(const PgnWriter&) = delete;
+	~PgnWriter();
+
+public:
+	// Truncates the file unless append is set, returns false if it cannot be opened
+	bool open(const char* path, bool append = false);
+	// Both return false if any write since open failed, the file then misses games
+	bool close();
+	void write(const PgnRecord& record, GameResult result, const PgnTags& tags);
+	bool flush();
+};
+// Receives the games of one part of a PGN file, each reading thread uses its own visitor
+class PgnVisitor {
+public:
+	virtual inline ~PgnVisitor() {}
+	// Tag pair of the game about to be replayed, the text is not terminated
+	virtual inline void tag(const char* name, size_t name_length, const char* value, size_t value_length) {}
+	// Called with the position before the move is played
+	virtual inline void move(const Board& board, Color turn, Move move) {}
+	// legal is false if a move could not be decoded, the rest of that game is skipped
+	virtual inline void end_game(GameResult result, bool legal) {}
+};
+struct PgnStats {
+	uint64_t games{0};
+	uint64_t plies{0};
+	uint64_t errors{0}; // games with a move that could not be decoded
+	uint32_t milliseconds{0};
+};
+// Read only mapping of a PGN file, replayed move by move without copying the text
+class PgnFile {
+	const char* m_text{nullptr};
+	size_t      m_size{0};
+
+public:
+	PgnFile() {}
+	PgnFile(const PgnFile&) = delete;
+	~PgnFile();
+
+public:
+	bool open(const char* path);
+	void close();
+	// Splits the file at game boundaries and replays the parts on threads threads, visitors[i] serves thread i
+	PgnStats replay(PgnVisitor* const* visitors, uint8_t threads) const;
+};
+// Position of a game as the binary record format stores it, in the byte order of the machine that wrote it
+struct PositionRecord {
+	uint32_t   board[8]; // nibbles as in Board::data()
+	int16_t    score;    // static evaluation for the side to move
+	uint16_t   move;     // Move::data() of the move played from the position
+	uint16_t   ply;      // plies played before the position
+	Color      turn;
+	GameResult result; // of the game the position comes from
+};
+static_assert(sizeof(PositionRecord) == 40, "records are stored as they are laid out in memory");
+// Records are compressed in blocks of this many unless a writer is told otherwise
+constexpr uint32_t record_block_size = 4096;
+// Larger blocks are rejected by writers and readers alike, a reader allocates a whole block up front
+constexpr uint32_t max_record_block_size = 1 << 20;
+// Appends records to a file behind a header, buffered and written in large batches, safe to call from several
+// threads. In compressed blocks every record is stored as its difference to the one before, so the positions of
+// a game should be written together.
+class RecordWriter {
+	struct State;
+	State* m_state{nullptr};
+
+public:
+	RecordWriter() {}
+	RecordWriter(const RecordWriter&) = delete;
+	~RecordWriter();
+
+public:
+	// Truncates the file, block_size 0 stores the records uncompressed, returns false if it cannot be opened or
+	// block_size is above max_record_block_size
+	bool open(const char* path, uint32_t block_size = record_block_size);
+	// Both return false if any write since open failed, the file then misses records
+	bool close();
+	void write(const PositionRecord* records, size_t count);
+	// Writes what is buffered, records short of a whole compressed block wait for close
+	bool flush();
+};
+// Read only mapping of a record file with random access by index. Blocks of an uncompressed file are the records
+// of the mapping itself, compressed ones are decoded into a buffer of the reader, so a reader serves one thread.
+class RecordFile {
+	const unsigned char*        m_data{nullptr};
+	size_t                      m_size{0}; // bytes of the mapping
+	size_t                      m_records{0};
+	uint32_t                    m_block_size{record_block_size};
+	bool                        m_compressed{false};
+	std::vector<size_t>         m_blocks{}; // offsets of the compressed blocks
+	std::vector<PositionRecord> m_decoded{};
+	size_t                      m_decoded_block{0};
+	size_t                      m_decoded_size{0}; // records in m_decoded, 0 when nothing is decoded
+
+public:
+	RecordFile() {}
+	RecordFile(const RecordFile&) = delete;
+	~RecordFile();
+
+public:
+	// Returns false if the file cannot be mapped or is not a valid record file
+	bool open(const char* path);
+	void close();
+	inline size_t size() const {
+		return m_records;
+	}
+	inline bool compressed() const {
+		return m_compressed;
+	}
+	inline size_t blocks() const {
+		return (m_records + m_block_size - 1) / m_block_size;
+	}
+	// Records of a block, count is set to how many, nullptr if the block is corrupt
+	const PositionRecord* block(size_t index, size_t& count);
+	// Returns false if the index is out of range or its block is corrupt
+	bool read(size_t index, PositionRecord& record);
+	// Every index once in random order, blocks are visited one after another in random order with the records of a
+	// block shuffled, so sampling a compressed file decodes each block once
+	void shuffle(uint64_t seed, std::vector<size_t>& order) const;
+};
+// Key of the position in the layout of the Polyglot book format
+uint64_t polyglot_key(const Board& board, Color turn);
+// Move in Polyglot encoding, castling is written as the king taking its own rook
+uint16_t polyglot_move(const Board& board, Move move);
+// Polyglot opening book searched in place in a shared read only mapping, so processes reading the same book
+// share one copy in the page cache, safe to probe from several threads
+class PolyglotBook {
+	const unsigned char* m_entries{nullptr};
+	size_t               m_size{0}; // entries of 16 bytes
+
+public:
+	PolyglotBook() {}
+	PolyglotBook(const PolyglotBook&) = delete;
+	~PolyglotBook();
+
+public:
+	// Returns false if the file cannot be mapped or is not made of whole entries
+	bool open(const char* path);
+	void close();
+	inline size_t size() const {
+		return m_size;
 	}
+	// Legal book move picked with a probability proportional to its weight, random is any 64-bit number,
+	// Move{} when the position is not in the book
+	Move probe(const Board& board, Color turn, const AvailableMoves& available, uint64_t random) const;
+};
+// Plays from the book while the position is in it and leaves the rest of the game to another player
+class BookPlayer : public Player {
+	const PolyglotBook& m_book;
+	Player&             m_player;
+	uint64_t            m_state;
+
+public:
+	BookPlayer(const PolyglotBook& book, Player& player, uint64_t seed);
+	Move get_move(const Game& game, const AvailableMoves& available) override;
+	void new_game() override;
 };
 } // namespace Engine
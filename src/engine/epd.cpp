@@ -0,0 +1,114 @@
+#include "engine.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+namespace Engine {
+namespace {
+// Longest line parsed, longer ones are rejected
+constexpr size_t max_line = 1024;
+// Parses the lines in [begin, end) of the mapped text
+void parse_lines(const char* text, size_t begin, size_t end, std::vector<EpdPosition>& positions, size_t& rejected) {
+	char  line[max_line];
+	Board board{};
+	while (begin < end) {
+		const char*  start   = text + begin;
+		const char*  newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+		const size_t length  = (newline != nullptr ? newline - start : end - begin);
+		begin += length + 1;
+		// Blank lines and comments are not positions
+		size_t first = 0;
+		while (first < length && (start[first] == ' ' || start[first] == '\t' || start[first] == '\r'))
+			first++;
+		if (first == length || start[first] == '#')
+			continue;
+		if (length >= max_line) {
+			rejected++;
+			continue;
+		}
+		std::memcpy(line, start, length);
+		line[length] = '\0';
+		EpdPosition position;
+		const char* rest;
+		if (!board.set_fen(line + first, position.turn, &rest)) {
+			rejected++;
+			continue;
+		}
+		while (*rest == ' ')
+			rest++;
+		size_t operations = length - (rest - line);
+		while (operations > 0 && (rest[operations - 1] == '\r' || rest[operations - 1] == ' '))
+			operations--;
+		std::memcpy(position.board, board.data(), sizeof(position.board));
+		position.operations = (start - text) + (rest - line);
+		position.length     = operations;
+		positions.push_back(position);
+	}
+}
+} // namespace
+EpdFile::~EpdFile() {
+	close();
+}
+void EpdFile::close() {
+	if (m_text != nullptr)
+		munmap(const_cast<char*>(m_text), m_size);
+	m_text = nullptr;
+	m_size = 0;
+	m_positions.clear();
+	m_rejected = 0;
+}
+bool EpdFile::open(const char* path, uint8_t threads) {
+	close();
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		::close(file);
+		return false;
+	}
+	if (status.st_size == 0) {
+		::close(file);
+		return true;
+	}
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapping == MAP_FAILED)
+		return false;
+	m_text = static_cast<const char*>(mapping);
+	m_size = status.st_size;
+	madvise(mapping, m_size, MADV_SEQUENTIAL);
+	// Chunks of the file end on line boundaries, each thread parses one into its own list
+	if (threads == 0)
+		threads = 1;
+	std::vector<size_t> bounds(threads + 1, m_size);
+	bounds[0] = 0;
+	for (uint8_t i = 1; i < threads; i++) {
+		size_t bound = m_size * i / threads;
+		if (bound < bounds[i - 1])
+			bound = bounds[i - 1];
+		const void* newline = std::memchr(m_text + bound, '\n', m_size - bound);
+		bounds[i]           = (newline != nullptr ? static_cast<const char*>(newline) - m_text + 1 : m_size);
+	}
+	std::vector<std::vector<EpdPosition>> chunks(threads);
+	std::vector<size_t>                   rejected(threads, 0);
+	std::vector<std::thread>              workers;
+	for (uint8_t i = 0; i < threads; i++) {
+		chunks[i].reserve((bounds[i + 1] - bounds[i]) / 64);
+		workers.emplace_back([&, i]() { parse_lines(m_text, bounds[i], bounds[i + 1], chunks[i], rejected[i]); });
+	}
+	for (std::thread& worker: workers)
+		worker.join();
+	size_t total = 0;
+	for (uint8_t i = 0; i < threads; i++)
+		total += chunks[i].size();
+	m_positions.reserve(total);
+	for (uint8_t i = 0; i < threads; i++) {
+		m_positions.insert(m_positions.end(), chunks[i].begin(), chunks[i].end());
+		m_rejected += rejected[i];
+	}
+	return true;
+}
+} // namespace Engine
@@ -0,0 +1,111 @@
+#include "engine.hpp"
+#include "profile.hpp"
+namespace Engine {
+namespace {
+constexpr int16_t piece_values[6] = {100, 320, 330, 500, 900, 0};
+// Piece-square tables from the point of view of white, rank 8 first and file A first
+constexpr int8_t piece_squares[7][64] = {
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    {
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    // King while pieces remain
+    {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20,
+    },
+    // King in the endgame
+    {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10,   0,   0, -10, -20, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -30,   0,   0,   0,   0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50,
+    },
+};
+// Square index to table index, black reads the tables mirrored vertically
+constexpr uint8_t table_index(uint8_t index, Color color) {
+	const uint8_t row = (color == Color::white ? index / 8 : 7 - index / 8);
+	return 8 * row + (7 - index % 8);
+}
+int16_t side_score(const Board& board, Color color, int16_t phase) {
+	int16_t result = 0;
+	for (uint8_t type = 0; type < 5; type++) {
+		for (uint64_t pieces = board.pieces(color, static_cast<PieceType>(type)); pieces != 0; pieces &= pieces - 1)
+			result += piece_values[type] + piece_squares[type][table_index(lowest_bit(pieces), color)];
+	}
+	const uint64_t king = board.pieces(color, PieceType::king);
+	if (king != 0) {
+		const uint8_t index = table_index(lowest_bit(king), color);
+		result += (piece_squares[5][index] * phase + piece_squares[6][index] * (24 - phase)) / 24;
+	}
+	return result;
+}
+} // namespace
+int16_t evaluate(const Board& board, Color color) {
+	PROFILE_SCOPE(evaluate);
+	// 24 with all pieces on the board, 0 with only kings and pawns left
+	int16_t phase = bit_count(board.pieces(PieceType::knight) | board.pieces(PieceType::bishop))
+	                + 2 * bit_count(board.pieces(PieceType::rook)) + 4 * bit_count(board.pieces(PieceType::queen));
+	if (phase > 24)
+		phase = 24;
+	const int16_t white = side_score(board, Color::white, phase);
+	const int16_t black = side_score(board, Color::black, phase);
+	return color == Color::white ? white - black : black - white;
+}
+} // namespace Engine
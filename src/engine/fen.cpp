@@ -0,0 +1,198 @@
+#include "engine.hpp"
+#include <cstring>
+namespace Engine {
+namespace {
+Piece fen_piece(char symbol) {
+	switch (symbol) {
+	case 'P': return Piece::white_pawn;
+	case 'N': return Piece::white_knight;
+	case 'B': return Piece::white_bishop;
+	case 'R': return Piece::white_rook_moved;
+	case 'Q': return Piece::white_queen;
+	case 'K': return Piece::white_king;
+	case 'p': return Piece::black_pawn;
+	case 'n': return Piece::black_knight;
+	case 'b': return Piece::black_bishop;
+	case 'r': return Piece::black_rook_moved;
+	case 'q': return Piece::black_queen;
+	case 'k': return Piece::black_king;
+	default: return Piece::empty;
+	}
+}
+constexpr char fen_symbols[16] = {0, 'P', 'R', 'N', 'B', 'Q', 'R', 'K', 0, 'p', 'r', 'n', 'b', 'q', 'r', 'k'};
+// Reads a decimal counter, returns nullptr if there is none
+const char* parse_counter(const char* text, uint32_t& value) {
+	if (*text < '0' || *text > '9')
+		return nullptr;
+	value = 0;
+	for (; *text >= '0' && *text <= '9'; text++) {
+		value = value * 10 + (*text - '0');
+		if (value > 0xFFFF)
+			return nullptr;
+	}
+	return text;
+}
+// One king, at most 16 pieces and 8 pawns, none on the first or last rank, and no more promoted pieces than
+// missing pawns. Move generation relies on this, no such position has more moves than AvailableMoves holds.
+bool material_possible(const Board& board, Color color) {
+	const uint8_t pawns = bit_count(board.pieces(color, PieceType::pawn));
+	if (bit_count(board.pieces(color, PieceType::king)) != 1 || bit_count(board.pieces(color)) > 16 || pawns > 8
+	    || (board.pieces(color, PieceType::pawn) & 0xFF000000000000FFULL) != 0)
+		return false;
+	auto extra = [&](PieceType type, uint8_t initial) {
+		const uint8_t count = bit_count(board.pieces(color, type));
+		return count > initial ? count - initial : 0;
+	};
+	return extra(PieceType::queen, 1) + extra(PieceType::rook, 2) + extra(PieceType::bishop, 2)
+	           + extra(PieceType::knight, 2)
+	       <= 8 - pawns;
+}
+} // namespace
+bool Board::set_fen(const char* fen, Color& turn, const char** rest) {
+	// Parsed aside so a malformed position leaves this board as it was
+	Board board{};
+	Color side;
+	std::memset(board.m_data, 0, sizeof(board.m_data));
+	// Piece placement, from rank 8 to rank 1 and from file A to file H
+	uint8_t row = 0, file = 0;
+	for (; *fen != ' '; fen++) {
+		if (*fen == '\0')
+			return false;
+		if (*fen == '/') {
+			if (file != 8 || ++row >= 8)
+				return false;
+			file = 0;
+		} else if (*fen >= '1' && *fen <= '8') {
+			file += *fen - '0';
+		} else {
+			const Piece piece = fen_piece(*fen);
+			if (piece == Piece::empty || file >= 8)
+				return false;
+			board.m_data[row] |= static_cast<uint32_t>(piece) << ((7 - file) * 4);
+			file++;
+		}
+		if (file > 8)
+			return false;
+	}
+	if (row != 7 || file != 8)
+		return false;
+	// Side to move
+	fen++;
+	if (*fen == 'w')
+		side = Color::white;
+	else if (*fen == 'b')
+		side = Color::black;
+	else
+		return false;
+	if (*++fen != ' ')
+		return false;
+	board.sync_bitboards(side);
+	// Castling rights, stored as the unmoved state of the corner rooks
+	for (fen++; *fen != ' '; fen++) {
+		uint8_t index;
+		Piece   rook;
+		switch (*fen) {
+		case 'K': index = 56, rook = Piece::white_rook_moved; break;
+		case 'Q': index = 63, rook = Piece::white_rook_moved; break;
+		case 'k': index = 0, rook = Piece::black_rook_moved; break;
+		case 'q': index = 7, rook = Piece::black_rook_moved; break;
+		case '-': continue;
+		default: return false;
+		}
+		if (board.get_piece(index) == rook)
+			board.set_piece(index,
+			                rook == Piece::white_rook_moved ? Piece::white_rook_unmoved : Piece::black_rook_unmoved);
+	}
+	// En passant target square, behind a pawn of the side that just moved
+	fen++;
+	if (*fen >= 'a' && *fen <= 'h' && fen[1] == (side == Color::white ? '6' : '3')) {
+		const uint8_t index = 8 * ('8' - fen[1]) + ('h' - fen[0]);
+		const uint8_t pawn  = (side == Color::white ? index + 8 : index - 8);
+		if (board.get_piece(index) != Piece::empty
+		    || board.get_piece(pawn) != (side == Color::white ? Piece::black_pawn : Piece::white_pawn))
+			return false;
+		board.set_piece(index, Piece::en_passant);
+		fen += 2;
+	} else if (*fen == '-')
+		fen++;
+	else
+		return false;
+	if (!material_possible(board, Color::white) || !material_possible(board, Color::black))
+		return false;
+	set_data(board.m_data, side);
+	turn = side;
+	if (rest != nullptr)
+		*rest = fen;
+	return true;
+}
+char* Board::get_fen(Color turn, char* fen) const {
+	for (uint8_t row = 0; row < 8; row++) {
+		uint8_t empty = 0;
+		for (uint8_t file = 0; file < 8; file++) {
+			const Piece piece = get_piece(8 * row + 7 - file);
+			if (piece_color(piece) == Color::none) {
+				empty++;
+				continue;
+			}
+			if (empty != 0)
+				*fen++ = '0' + empty;
+			empty  = 0;
+			*fen++ = fen_symbols[static_cast<uint8_t>(piece)];
+		}
+		if (empty != 0)
+			*fen++ = '0' + empty;
+		*fen++ = (row == 7 ? ' ' : '/');
+	}
+	*fen++ = (turn == Color::white ? 'w' : 'b');
+	*fen++ = ' ';
+	const char* castling = fen;
+	if (get_piece(56) == Piece::white_rook_unmoved)
+		*fen++ = 'K';
+	if (get_piece(63) == Piece::white_rook_unmoved)
+		*fen++ = 'Q';
+	if (get_piece(0) == Piece::black_rook_unmoved)
+		*fen++ = 'k';
+	if (get_piece(7) == Piece::black_rook_unmoved)
+		*fen++ = 'q';
+	if (fen == castling)
+		*fen++ = '-';
+	*fen++ = ' ';
+	const uint64_t markers = pieces(PieceType::en_passant);
+	if (markers != 0) {
+		*fen++ = 'h' - lowest_bit(markers) % 8;
+		*fen++ = '8' - lowest_bit(markers) / 8;
+	} else
+		*fen++ = '-';
+	*fen = '\0';
+	return fen;
+}
+bool Game::set_fen(const char* fen) {
+	Board       board{};
+	Color       turn;
+	const char* rest;
+	if (!board.set_fen(fen, turn, &rest))
+		return false;
+	uint32_t halfmove = 0, fullmove = 1;
+	while (*rest == ' ')
+		rest++;
+	if (*rest != '\0') {
+		rest = parse_counter(rest, halfmove);
+		if (rest == nullptr || *rest++ != ' ' || halfmove > 0xFF)
+			return false;
+		rest = parse_counter(rest, fullmove);
+		if (rest == nullptr || fullmove == 0 || 2 * (fullmove - 1) + 1 > 0xFFFF)
+			return false;
+	}
+	m_board.set_data(board.data(), turn);
+	m_turn          = turn;
+	m_50_move_timer = halfmove;
+	m_turn_number   = 2 * (fullmove - 1) + (turn == Color::black ? 1 : 0);
+	m_termination   = Termination::none;
+	m_history.assign(1, m_board.hash());
+	return true;
+}
+char* Game::get_fen(char* fen) const {
+	fen = m_board.get_fen(m_turn, fen);
+	return fen + sprintf(fen, " %u %u", m_50_move_timer, m_turn_number / 2 + 1);
+}
+} // namespace Engine
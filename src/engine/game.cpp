@@ -1,15 +1,101 @@
 #include "engine.hpp"
+#include "profile.hpp"
+#include "util.hpp"
 namespace Engine {
-Game::Game(Player* white, Player* black) : m_white(white), m_black(black) {}
-void Game::advance_turn() {
-	AvailableMoves available{m_board, m_turn};
-	Move move = (m_turn == Color::white ? m_white : m_black)->get_move(available);
-	if (move.is_capture(m_board))
+namespace {
+constexpr uint64_t dark_squares = 0xAA55AA55AA55AA55ULL;
+// No sequence of legal moves mates: bare kings, a single minor piece, or bishops all on one square colour
+bool insufficient_material(const Board& board) {
+	if ((board.pieces(PieceType::pawn) | board.pieces(PieceType::rook) | board.pieces(PieceType::queen)) != 0)
+		return false;
+	const uint64_t bishops = board.pieces(PieceType::bishop);
+	if (bit_count(board.pieces(PieceType::knight) | bishops) <= 1)
+		return true;
+	return board.pieces(PieceType::knight) == 0 && ((bishops & dark_squares) == 0 || (bishops & ~dark_squares) == 0);
+}
+} // namespace
+Game::Game(Player* white, Player* black) : m_white(white), m_black(black) {
+	// The fifty-move rule ends the game before the history outgrows this, so no ply allocates
+	m_history.reserve(101);
+	m_history.push_back(m_board.hash());
+}
+Color Game::get_winner() const {
+	if (m_termination != Termination::checkmate)
+		return Color::none;
+	return m_turn == Color::white ? Color::black : Color::white;
+}
+GameResult Game::get_result() const {
+	switch (m_termination) {
+	case Termination::none: return GameResult::unknown;
+	case Termination::checkmate: return m_turn == Color::white ? GameResult::black_wins : GameResult::white_wins;
+	case Termination::stalemate:
+	case Termination::fifty_moves:
+	case Termination::repetition:
+	case Termination::insufficient_material: break;
+	}
+	return GameResult::draw;
+}
+void Game::record(PgnRecord* record) {
+	m_record = record;
+	if (m_record != nullptr)
+		m_record->start(*this);
+}
+bool Game::check_termination(const AvailableMoves& available) {
+	if (m_termination != Termination::none)
+		return true;
+	if (available.count() == 0) {
+		m_termination = (available.in_check() ? Termination::checkmate : Termination::stalemate);
+		return true;
+	}
+	// A mate on the hundredth ply still counts, so the draws are only checked once moves are known to exist
+	if (m_50_move_timer >= 100) {
+		m_termination = Termination::fifty_moves;
+		return true;
+	}
+	// The current position against every earlier one with the same side to move
+	uint8_t repetitions = 1;
+	for (size_t i = m_history.size() - 1; i >= 2 && repetitions < 3;) {
+		i -= 2;
+		repetitions += m_history[i] == m_history.back();
+	}
+	if (repetitions >= 3) {
+		m_termination = Termination::repetition;
+		return true;
+	}
+	if (insufficient_material(m_board)) {
+		m_termination = Termination::insufficient_material;
+		return true;
+	}
+	return false;
+}
+void Game::play(Move move) {
+	if (m_record != nullptr)
+		m_record->add(m_board, m_turn, move);
+	if (move.is_capture(m_board) || piece_type(m_board.get_piece(move.from())) == PieceType::pawn) {
 		m_50_move_timer = 0;
-	else
+		m_history.clear();
+	} else
 		m_50_move_timer++;
 	m_turn_number++;
+	m_last_move = move;
 	m_board.make_move(move);
+	m_history.push_back(m_board.hash());
 	m_turn = (m_turn == Color::white ? Color::black : Color::white);
 }
+void Game::advance_turn() {
+	if (m_termination != Termination::none)
+		return;
+	const AvailableMoves available{m_board, m_turn};
+	if (check_termination(available))
+		return;
+	Move move;
+	{
+		PROFILE_SCOPE(get_move);
+		move = (m_turn == Color::white ? m_white : m_black)->get_move(*this, available);
+	}
+	play(move);
+}
+Move RandomPlayer::get_move(const Game& game, const AvailableMoves& available) {
+	return available.begin()[splitmix64(m_state) % available.count()];
+}
 } // namespace Engine
@@ -1,6 +1,9 @@
 #include "engine.hpp"
 namespace Engine {
-bool Move::is_capture(const Board& board) {
-	return false;
+bool Move::is_capture(const Board& board) const {
+	const Piece target = board.get_piece(to());
+	if (piece_color(target) != Color::none)
+		return true;
+	return target == Piece::en_passant && piece_type(board.get_piece(from())) == PieceType::pawn;
 }
 } // namespace Engine
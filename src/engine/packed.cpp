@@ -0,0 +1,143 @@
+#include "engine.hpp"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKED_X86
+#endif
+namespace Engine {
+namespace {
+void unpack_scalar(const uint32_t* data, PackedBitboards& bitboards) {
+	std::memset(&bitboards, 0, sizeof(bitboards));
+	for (uint8_t i = 0; i < 64; i++) {
+		const Piece piece = static_cast<Piece>((data[i / 8] >> ((i % 8) * 4)) & 0x0F);
+		bitboards.types[static_cast<uint8_t>(piece_type(piece))] |= 1ULL << i;
+		bitboards.colors[static_cast<uint8_t>(piece_color(piece))] |= 1ULL << i;
+	}
+}
+void count_scalar(const uint32_t* data, PieceCounts& counts) {
+	std::memset(&counts, 0, sizeof(counts));
+	for (uint8_t row = 0; row < 8; row++) {
+		for (uint8_t shift = 0; shift < 32; shift += 4)
+			counts.pieces[(data[row] >> shift) & 0x0F]++;
+	}
+}
+#ifdef PACKED_X86
+#define PACKED_AVX2 __attribute__((target("avx2")))
+// Spreads the 64 nibbles to one byte per square, squares 0-31 in low and 32-63 in high
+PACKED_AVX2 inline void spread(const uint32_t* data, __m256i& low, __m256i& high) {
+	const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	// Byte i holds square 2i in its low nibble and square 2i + 1 in its high one
+	const __m256i even = _mm256_and_si256(packed, nibble);
+	const __m256i odd  = _mm256_and_si256(_mm256_srli_epi16(packed, 4), nibble);
+	// Interleaving works within each 128-bit lane: squares 0-15 and 32-47, then 16-31 and 48-63
+	const __m256i first  = _mm256_unpacklo_epi8(even, odd);
+	const __m256i second = _mm256_unpackhi_epi8(even, odd);
+	low                  = _mm256_permute2x128_si256(first, second, 0x20);
+	high                 = _mm256_permute2x128_si256(first, second, 0x31);
+}
+// Bitboard of the squares whose byte equals the value
+PACKED_AVX2 inline uint64_t squares_with(__m256i low, __m256i high, uint8_t value) {
+	const __m256i wanted = _mm256_set1_epi8(value);
+	return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, wanted)))
+	       | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, wanted)))) << 32;
+}
+PACKED_AVX2 inline void unpack_avx2(const uint32_t* data, PackedBitboards& bitboards) {
+	// PieceType and Color of every nibble, looked up for all squares at once, the table repeats in both lanes
+	const __m256i types  = _mm256_setr_epi8(7, 0, 3, 1, 2, 4, 3, 5, 6, 0, 3, 1, 2, 4, 3, 5, //
+	                                        7, 0, 3, 1, 2, 4, 3, 5, 6, 0, 3, 1, 2, 4, 3, 5);
+	const __m256i colors = _mm256_setr_epi8(2, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 1, 1, 1, 1, 1, //
+	                                        2, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 1, 1, 1, 1, 1);
+	__m256i       low, high;
+	spread(data, low, high);
+	const __m256i type_low  = _mm256_shuffle_epi8(types, low);
+	const __m256i type_high = _mm256_shuffle_epi8(types, high);
+	for (uint8_t type = 0; type < 8; type++)
+		bitboards.types[type] = squares_with(type_low, type_high, type);
+	const __m256i color_low  = _mm256_shuffle_epi8(colors, low);
+	const __m256i color_high = _mm256_shuffle_epi8(colors, high);
+	bitboards.colors[0]      = squares_with(color_low, color_high, 0);
+	bitboards.colors[1]      = squares_with(color_low, color_high, 1);
+	bitboards.colors[2]      = ~(bitboards.colors[0] | bitboards.colors[1]);
+}
+PACKED_AVX2 inline void count_avx2(const uint32_t* data, PieceCounts& counts) {
+	__m256i low, high;
+	spread(data, low, high);
+	for (uint8_t piece = 0; piece < 16; piece++)
+		counts.pieces[piece] = __builtin_popcountll(squares_with(low, high, piece));
+}
+PACKED_AVX2 void unpack_boards_avx2(const uint32_t* data, size_t stride, size_t count, PackedBitboards* bitboards) {
+	for (size_t i = 0; i < count; i++)
+		unpack_avx2(reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(data) + i * stride), bitboards[i]);
+}
+PACKED_AVX2 void count_pieces_avx2(const uint32_t* data, size_t stride, size_t count, PieceCounts* counts) {
+	for (size_t i = 0; i < count; i++)
+		count_avx2(reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(data) + i * stride), counts[i]);
+}
+PACKED_AVX2 bool same_board_avx2(const uint32_t* data, const uint32_t* other) {
+	const __m256i difference = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)),
+	                                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other)));
+	return _mm256_testz_si256(difference, difference);
+}
+bool avx2_supported() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#else
+bool avx2_supported() {
+	return false;
+}
+#endif
+// Boards built before this is initialised simply take the scalar path
+bool avx2 = avx2_supported();
+} // namespace
+void unpack_board(const uint32_t* data, PackedBitboards& bitboards) {
+#ifdef PACKED_X86
+	if (avx2) {
+		unpack_boards_avx2(data, 0, 1, &bitboards);
+		return;
+	}
+#endif
+	unpack_scalar(data, bitboards);
+}
+void unpack_boards(const uint32_t* data, size_t stride, size_t count, PackedBitboards* bitboards) {
+#ifdef PACKED_X86
+	if (avx2) {
+		unpack_boards_avx2(data, stride, count, bitboards);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; i++)
+		unpack_scalar(reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(data) + i * stride), bitboards[i]);
+}
+void count_pieces(const uint32_t* data, PieceCounts& counts) {
+#ifdef PACKED_X86
+	if (avx2) {
+		count_pieces_avx2(data, 0, 1, &counts);
+		return;
+	}
+#endif
+	count_scalar(data, counts);
+}
+void count_pieces(const uint32_t* data, size_t stride, size_t count, PieceCounts* counts) {
+#ifdef PACKED_X86
+	if (avx2) {
+		count_pieces_avx2(data, stride, count, counts);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; i++)
+		count_scalar(reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(data) + i * stride), counts[i]);
+}
+bool same_board(const uint32_t* data, const uint32_t* other) {
+#ifdef PACKED_X86
+	if (avx2)
+		return same_board_avx2(data, other);
+#endif
+	return std::memcmp(data, other, 8 * sizeof(uint32_t)) == 0;
+}
+bool use_avx2(bool enabled) {
+	avx2 = enabled && avx2_supported();
+	return avx2;
+}
+} // namespace Engine
@@ -0,0 +1,382 @@
+#include "engine.hpp"
+#include "util.hpp"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+namespace Engine {
+namespace {
+constexpr const char* initial_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// Buffered text is written out once it grows past this
+constexpr size_t flush_size = 1 << 20;
+const char* result_text(GameResult result) {
+	switch (result) {
+	case GameResult::white_wins: return "1-0";
+	case GameResult::black_wins: return "0-1";
+	case GameResult::draw: return "1/2-1/2";
+	case GameResult::unknown: break;
+	}
+	return "*";
+}
+void append(std::vector<char>& text, const char* string, size_t length) {
+	text.insert(text.end(), string, string + length);
+}
+void append(std::vector<char>& text, const char* string) {
+	append(text, string, std::strlen(string));
+}
+void append_tag(std::vector<char>& text, const char* name, const char* value) {
+	text.push_back('[');
+	append(text, name);
+	append(text, " \"");
+	for (; *value != '\0'; value++) {
+		if (*value == '"' || *value == '\\')
+			text.push_back('\\');
+		text.push_back(*value);
+	}
+	append(text, "\"]\n");
+}
+// Movetext lines are wrapped before 80 columns as the export format asks
+void append_token(std::vector<char>& text, size_t& column, const char* token, size_t length) {
+	if (column != 0 && column + 1 + length >= 80) {
+		text.push_back('\n');
+		column = 0;
+	} else if (column != 0) {
+		text.push_back(' ');
+		column++;
+	}
+	append(text, token, length);
+	column += length;
+}
+bool is_space(char symbol) {
+	return symbol == ' ' || symbol == '\n' || symbol == '\r' || symbol == '\t';
+}
+// Replays the games of one part of the mapped file
+class PgnParser {
+	const char* m_text;
+	const char* m_end;
+	PgnVisitor& m_visitor;
+	PgnStats&   m_stats;
+	Board       m_board{};
+	Color       m_turn{Color::white};
+	bool        m_in_game{false};
+	bool        m_error{false};
+
+public:
+	PgnParser(const char* begin, const char* end, PgnVisitor& visitor, PgnStats& stats) :
+	    m_text(begin), m_end(end), m_visitor(visitor), m_stats(stats) {}
+
+private:
+	void begin_game() {
+		const Board initial{};
+		m_board.set_data(initial.data(), Color::white);
+		m_turn    = Color::white;
+		m_in_game = true;
+		m_error   = false;
+	}
+	void end_game(GameResult result) {
+		if (!m_in_game)
+			return;
+		m_visitor.end_game(result, !m_error);
+		m_stats.games++;
+		m_stats.errors += m_error;
+		m_in_game = false;
+	}
+	const char* skip_until(const char* text, char symbol) const {
+		const void* found = std::memchr(text, symbol, m_end - text);
+		return found != nullptr ? static_cast<const char*>(found) + 1 : m_end;
+	}
+	const char* parse_tag(const char* text, bool& tags_open) {
+		// A tag after movetext starts the next game even if the last one had no result
+		if (!tags_open)
+			end_game(GameResult::unknown);
+		if (!m_in_game)
+			begin_game();
+		tags_open        = true;
+		const char* name = ++text;
+		while (text < m_end && !is_space(*text) && *text != ']')
+			text++;
+		const size_t name_length = text - name;
+		while (text < m_end && *text != '"' && *text != ']')
+			text++;
+		if (text >= m_end || *text == ']')
+			return text + 1;
+		const char* value = ++text;
+		while (text < m_end && *text != '"')
+			text += (*text == '\\' ? 2 : 1);
+		if (text > m_end)
+			text = m_end;
+		const size_t value_length = text - value;
+		m_visitor.tag(name, name_length, value, value_length);
+		if (name_length == 3 && std::memcmp(name, "FEN", 3) == 0) {
+			char fen[fen_size];
+			m_error |= value_length >= fen_size;
+			if (!m_error) {
+				std::memcpy(fen, value, value_length);
+				fen[value_length] = '\0';
+				m_error           = !m_board.set_fen(fen, m_turn);
+			}
+		}
+		return skip_until(text, ']');
+	}
+	const char* skip_variation(const char* text) const {
+		uint32_t depth = 0;
+		for (; text < m_end; text++) {
+			if (*text == '{')
+				text = skip_until(text, '}') - 1;
+			else if (*text == '(')
+				depth++;
+			else if (*text == ')' && --depth == 0)
+				return text + 1;
+		}
+		return m_end;
+	}
+	void play(const char* san, size_t length) {
+		if (!m_in_game)
+			begin_game();
+		if (m_error)
+			return;
+		const AvailableMoves available{m_board, m_turn};
+		const Move           move = parse_san(m_board, available, san, length);
+		if (move == Move{}) {
+			m_error = true;
+			return;
+		}
+		m_visitor.move(m_board, m_turn, move);
+		m_board.make_move(move);
+		m_turn = (m_turn == Color::white ? Color::black : Color::white);
+		m_stats.plies++;
+	}
+
+public:
+	void run() {
+		bool tags_open = false;
+		for (const char* text = m_text; text < m_end;) {
+			const char symbol = *text;
+			if (is_space(symbol)) {
+				text++;
+				continue;
+			}
+			if (symbol == '[') {
+				text = parse_tag(text, tags_open);
+				continue;
+			}
+			tags_open = false;
+			if (symbol == '{')
+				text = skip_until(text, '}');
+			else if (symbol == ';' || (symbol == '%' && (text == m_text || text[-1] == '\n')))
+				text = skip_until(text, '\n');
+			else if (symbol == '(')
+				text = skip_variation(text);
+			else if (symbol == '*') {
+				end_game(GameResult::unknown);
+				text++;
+			} else {
+				const char* token = text;
+				while (text < m_end && !is_space(*text) && std::strchr("[]{}();", *text) == nullptr)
+					text++;
+				// Stray closing brackets and bytes such as NUL end the token before it starts, they are skipped
+				if (text == token) {
+					text++;
+					continue;
+				}
+				if (*token == '$')
+					continue;
+				const size_t length = text - token;
+				if (length == 3 && std::memcmp(token, "1-0", 3) == 0)
+					end_game(GameResult::white_wins);
+				else if (length == 3 && std::memcmp(token, "0-1", 3) == 0)
+					end_game(GameResult::black_wins);
+				else if (length == 7 && std::memcmp(token, "1/2-1/2", 7) == 0)
+					end_game(GameResult::draw);
+				else {
+					// Move numbers may be glued to the move that follows them
+					const char* san = token;
+					if (*san >= '1' && *san <= '9') {
+						while (san < text && *san >= '0' && *san <= '9')
+							san++;
+						while (san < text && *san == '.')
+							san++;
+					}
+					if (san < text)
+						play(san, text - san);
+				}
+			}
+		}
+		end_game(GameResult::unknown);
+	}
+};
+} // namespace
+void PgnRecord::start(const Game& game) {
+	game.get_fen(m_fen);
+	if (std::strcmp(m_fen, initial_fen) == 0)
+		m_fen[0] = '\0';
+	m_first_ply = game.get_turn_number();
+	m_plies     = 0;
+	m_moves.clear();
+}
+void PgnRecord::add(const Board& board, Color turn, Move move) {
+	char san[16];
+	if (!m_moves.empty())
+		m_moves.push_back(' ');
+	append(m_moves, san, write_san(board, turn, move, san) - san);
+	m_plies++;
+}
+struct PgnWriter::State {
+	int               file;
+	std::mutex        mutex;
+	std::vector<char> buffer;
+	bool              failed{false}; // a write failed, games are missing from the file
+	void write_buffer() {
+		failed |= !write_all(file, buffer.data(), buffer.size());
+		buffer.clear();
+	}
+};
+PgnWriter::~PgnWriter() {
+	close();
+}
+bool PgnWriter::open(const char* path, bool append) {
+	close();
+	const int file = ::open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+	if (file < 0)
+		return false;
+	m_state       = new State;
+	m_state->file = file;
+	m_state->buffer.reserve(flush_size);
+	return true;
+}
+bool PgnWriter::close() {
+	if (m_state == nullptr)
+		return true;
+	const bool written = flush() && ::close(m_state->file) == 0;
+	delete m_state;
+	m_state = nullptr;
+	return written;
+}
+void PgnWriter::write(const PgnRecord& record, GameResult result, const PgnTags& tags) {
+	if (m_state == nullptr)
+		return;
+	// The game is formatted outside the lock into a buffer every thread reuses, writers only contend for the copy
+	// into the shared buffer
+	thread_local std::vector<char> text;
+	text.clear();
+	text.reserve(512 + record.moves().size() * 2);
+	char       number[32];
+	const auto now = time(nullptr);
+	struct tm  date;
+	localtime_r(&now, &date);
+	append_tag(text, "Event", tags.event);
+	append_tag(text, "Site", "?");
+	strftime(number, sizeof(number), "%Y.%m.%d", &date);
+	append_tag(text, "Date", number);
+	snprintf(number, sizeof(number), "%u", tags.round);
+	append_tag(text, "Round", tags.round == 0 ? "?" : number);
+	append_tag(text, "White", tags.white);
+	append_tag(text, "Black", tags.black);
+	append_tag(text, "Result", result_text(result));
+	if (record.fen()[0] != '\0') {
+		append_tag(text, "SetUp", "1");
+		append_tag(text, "FEN", record.fen());
+	}
+	text.push_back('\n');
+	size_t                   column = 0;
+	const std::vector<char>& moves  = record.moves();
+	size_t                   start  = 0;
+	for (uint16_t i = 0; i < record.plies(); i++) {
+		const uint16_t ply = record.first_ply() + i;
+		if (ply % 2 == 0 || i == 0) {
+			const int length = snprintf(number, sizeof(number), ply % 2 == 0 ? "%u." : "%u...", ply / 2 + 1);
+			append_token(text, column, number, length);
+		}
+		size_t end = start;
+		while (end < moves.size() && moves[end] != ' ')
+			end++;
+		append_token(text, column, moves.data() + start, end - start);
+		start = end + 1;
+	}
+	const char* ending = result_text(result);
+	append_token(text, column, ending, std::strlen(ending));
+	append(text, "\n\n");
+	std::lock_guard<std::mutex> lock{m_state->mutex};
+	append(m_state->buffer, text.data(), text.size());
+	if (m_state->buffer.size() >= flush_size)
+		m_state->write_buffer();
+}
+bool PgnWriter::flush() {
+	if (m_state == nullptr)
+		return true;
+	std::lock_guard<std::mutex> lock{m_state->mutex};
+	m_state->write_buffer();
+	return !m_state->failed;
+}
+PgnFile::~PgnFile() {
+	close();
+}
+bool PgnFile::open(const char* path) {
+	close();
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		::close(file);
+		return false;
+	}
+	if (status.st_size == 0) {
+		::close(file);
+		return true;
+	}
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapping == MAP_FAILED)
+		return false;
+	m_text = static_cast<const char*>(mapping);
+	m_size = status.st_size;
+	madvise(mapping, m_size, MADV_SEQUENTIAL);
+	return true;
+}
+void PgnFile::close() {
+	if (m_text != nullptr)
+		munmap(const_cast<char*>(m_text), m_size);
+	m_text = nullptr;
+	m_size = 0;
+}
+PgnStats PgnFile::replay(PgnVisitor* const* visitors, uint8_t threads) const {
+	const auto start = std::chrono::steady_clock::now();
+	if (threads == 0)
+		threads = 1;
+	// Parts start at an Event tag on its own line, which the seven tag roster puts first in every game
+	std::vector<size_t> bounds(threads + 1, m_size);
+	bounds[0] = 0;
+	for (uint8_t i = 1; i < threads; i++) {
+		size_t bound = m_size * i / threads;
+		if (bound < bounds[i - 1])
+			bound = bounds[i - 1];
+		const char* found = static_cast<const char*>(memmem(m_text + bound, m_size - bound, "\n[Event ", 8));
+		bounds[i]         = (found != nullptr ? found - m_text + 1 : m_size);
+	}
+	std::vector<PgnStats>    stats(threads);
+	std::vector<std::thread> workers;
+	for (uint8_t i = 0; i < threads; i++) {
+		workers.emplace_back([&, i]() {
+			PgnParser parser{m_text + bounds[i], m_text + bounds[i + 1], *visitors[i], stats[i]};
+			parser.run();
+		});
+	}
+	for (std::thread& worker: workers)
+		worker.join();
+	PgnStats result;
+	for (const PgnStats& part: stats) {
+		result.games += part.games;
+		result.plies += part.plies;
+		result.errors += part.errors;
+	}
+	result.milliseconds =
+	    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+} // namespace Engine
@@ -0,0 +1,217 @@
+#include "profile.hpp"
+#if defined(PROFILE) || defined(ALLOCATION_AUDIT)
+#include <cstdio>
+namespace Engine {
+namespace Profile {
+namespace {
+constexpr uint8_t     phase_count              = static_cast<uint8_t>(Phase::count);
+constexpr const char* phase_names[phase_count] = {"available_moves", "make_move", "unmake_move", "evaluate",
+                                                  "node",            "search",    "get_move",    "render"};
+} // namespace
+} // namespace Profile
+} // namespace Engine
+#endif
+#ifdef PROFILE
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+namespace Engine {
+namespace Profile {
+namespace {
+constexpr uint8_t     counter_count                = static_cast<uint8_t>(Counter::count);
+constexpr const char* counter_names[counter_count] = {"moves_generated", "nodes"};
+constexpr uint8_t     buckets                      = 64; // bucket i > 0 holds the values from 2^(i-1) below 2^i
+struct Aggregate {
+	uint64_t samples{0};
+	uint64_t sum{0};
+	uint64_t histogram[buckets]{};
+	inline void add(uint64_t value) {
+		samples++;
+		sum += value;
+		histogram[value == 0 ? 0 : std::min(64 - __builtin_clzll(value), buckets - 1)]++;
+	}
+	void merge(const Aggregate& other) {
+		samples += other.samples;
+		sum += other.sum;
+		for (uint8_t i = 0; i < buckets; i++)
+			histogram[i] += other.histogram[i];
+	}
+	// Upper bound of the bucket holding the given share of the samples
+	uint64_t percentile(double share) const {
+		uint64_t seen = 0;
+		for (uint8_t i = 0; i < buckets; i++) {
+			seen += histogram[i];
+			if (seen > 0 && seen >= share * samples)
+				return i == 0 ? 0 : (1ULL << i) - 1;
+		}
+		return 0;
+	}
+};
+struct Aggregates {
+	Aggregate phases[phase_count];
+	Aggregate counters[counter_count];
+	void merge(const Aggregates& other) {
+		for (uint8_t i = 0; i < phase_count; i++)
+			phases[i].merge(other.phases[i]);
+		for (uint8_t i = 0; i < counter_count; i++)
+			counters[i].merge(other.counters[i]);
+	}
+};
+// Totals of the threads that have exited, written out once the last thread is done with it
+class Registry {
+	std::mutex                                  m_mutex;
+	Aggregates                                  m_totals;
+	const std::chrono::steady_clock::time_point m_start{std::chrono::steady_clock::now()};
+	const uint64_t                              m_start_ticks{ticks()};
+
+public:
+	void merge(const Aggregates& aggregates) {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_totals.merge(aggregates);
+	}
+	~Registry();
+};
+Registry& registry() {
+	static Registry instance;
+	return instance;
+}
+// Constructed on the first record of a thread, so the registry outlives it
+struct ThreadAggregates {
+	Aggregates aggregates;
+	ThreadAggregates() {
+		registry();
+	}
+	~ThreadAggregates() {
+		registry().merge(aggregates);
+	}
+};
+thread_local ThreadAggregates local;
+Registry::~Registry() {
+	const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+	const uint64_t elapsed_ticks = ticks() - m_start_ticks;
+	// Ticks are converted with the rate they advanced at over the whole run
+	const double nanoseconds = (elapsed_ticks > 0 ? elapsed / elapsed_ticks : 1.0);
+	const Aggregate& search    = m_totals.phases[static_cast<uint8_t>(Phase::search)];
+	const Aggregate& nodes     = m_totals.counters[static_cast<uint8_t>(Counter::nodes)];
+	const Aggregate& generated = m_totals.counters[static_cast<uint8_t>(Counter::moves_generated)];
+	const double     nodes_per_second = (search.sum > 0 ? nodes.sum / (search.sum * nanoseconds / 1e9) : 0.0);
+	const double     moves_per_position =
+	    (generated.samples > 0 ? static_cast<double>(generated.sum) / generated.samples : 0.0);
+	fprintf(stderr, "%-16s %12s %12s %10s %10s %10s\n", "phase", "calls", "total ms", "mean ns", "p50 ns", "p99 ns");
+	for (uint8_t i = 0; i < phase_count; i++) {
+		const Aggregate& phase = m_totals.phases[i];
+		if (phase.samples == 0)
+			continue;
+		fprintf(stderr, "%-16s %12lu %12.1f %10.0f %10.0f %10.0f\n", phase_names[i],
+		        static_cast<unsigned long>(phase.samples), phase.sum * nanoseconds / 1e6,
+		        phase.sum * nanoseconds / phase.samples, phase.percentile(0.5) * nanoseconds,
+		        phase.percentile(0.99) * nanoseconds);
+	}
+	fprintf(stderr, "%-16s %12s %12s %10s\n", "counter", "samples", "sum", "mean");
+	for (uint8_t i = 0; i < counter_count; i++) {
+		const Aggregate& counter = m_totals.counters[i];
+		fprintf(stderr, "%-16s %12lu %12lu %10.1f\n", counter_names[i], static_cast<unsigned long>(counter.samples),
+		        static_cast<unsigned long>(counter.sum),
+		        counter.samples > 0 ? static_cast<double>(counter.sum) / counter.samples : 0.0);
+	}
+	fprintf(stderr, "nodes/s %.0f moves/position %.2f\n", nodes_per_second, moves_per_position);
+	FILE* json = fopen("profile.json", "w");
+	if (json == nullptr)
+		return;
+	fprintf(json, "{\n  \"nanoseconds_per_tick\": %.6f,\n  \"phases\": {", nanoseconds);
+	for (uint8_t i = 0; i < phase_count; i++) {
+		const Aggregate& phase = m_totals.phases[i];
+		fprintf(json, "%s\n    \"%s\": {\"calls\": %lu, \"nanoseconds\": %.0f, \"histogram\": [", i == 0 ? "" : ",",
+		        phase_names[i], static_cast<unsigned long>(phase.samples), phase.sum * nanoseconds);
+		for (uint8_t j = 0; j < buckets; j++)
+			fprintf(json, "%s%lu", j == 0 ? "" : ", ", static_cast<unsigned long>(phase.histogram[j]));
+		fprintf(json, "]}");
+	}
+	fprintf(json, "\n  },\n  \"counters\": {");
+	for (uint8_t i = 0; i < counter_count; i++) {
+		const Aggregate& counter = m_totals.counters[i];
+		fprintf(json, "%s\n    \"%s\": {\"samples\": %lu, \"sum\": %lu, \"histogram\": [", i == 0 ? "" : ",",
+		        counter_names[i], static_cast<unsigned long>(counter.samples), static_cast<unsigned long>(counter.sum));
+		for (uint8_t j = 0; j < buckets; j++)
+			fprintf(json, "%s%lu", j == 0 ? "" : ", ", static_cast<unsigned long>(counter.histogram[j]));
+		fprintf(json, "]}");
+	}
+	fprintf(json, "\n  },\n  \"nodes_per_second\": %.0f,\n  \"moves_per_position\": %.3f\n}\n", nodes_per_second,
+	        moves_per_position);
+	fclose(json);
+}
+} // namespace
+void record(Phase phase, uint64_t ticks) {
+	local.aggregates.phases[static_cast<uint8_t>(phase)].add(ticks);
+}
+void add(Counter counter, uint64_t value) {
+	local.aggregates.counters[static_cast<uint8_t>(counter)].add(value);
+}
+} // namespace Profile
+} // namespace Engine
+#endif
+#ifdef ALLOCATION_AUDIT
+#include <atomic>
+#include <cstdlib>
+#include <new>
+namespace {
+thread_local uint64_t thread_allocations = 0;
+std::atomic<uint64_t> total_allocations{0};
+// Every replaced operator new ends here, the memory is released with free
+void* allocate(size_t size, size_t alignment) {
+	thread_allocations++;
+	total_allocations.fetch_add(1, std::memory_order_relaxed);
+	void* memory = (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__
+	                    ? std::malloc(size == 0 ? 1 : size)
+	                    : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment));
+	if (memory == nullptr) {
+		fputs("out of memory\n", stderr);
+		std::abort();
+	}
+	return memory;
+}
+} // namespace
+namespace Engine {
+namespace Profile {
+namespace {
+std::atomic<uint64_t> phase_allocations[phase_count]{};
+// Written when the program exits
+struct AuditReport {
+	~AuditReport() {
+		fprintf(stderr, "%-16s %12s\n", "phase", "allocations");
+		for (uint8_t i = 0; i < phase_count; i++)
+			fprintf(stderr, "%-16s %12lu\n", phase_names[i],
+			        static_cast<unsigned long>(phase_allocations[i].load(std::memory_order_relaxed)));
+		fprintf(stderr, "%-16s %12lu\n", "total",
+		        static_cast<unsigned long>(total_allocations.load(std::memory_order_relaxed)));
+	}
+} report;
+} // namespace
+uint64_t allocations() {
+	return thread_allocations;
+}
+void audit(Phase phase, uint64_t allocations) {
+	if (allocations == 0)
+		return;
+	phase_allocations[static_cast<uint8_t>(phase)].fetch_add(allocations, std::memory_order_relaxed);
+	if (phase <= Phase::node) {
+		fprintf(stderr, "%lu heap allocations in %s, which must not allocate\n", static_cast<unsigned long>(allocations),
+		        phase_names[static_cast<uint8_t>(phase)]);
+		std::abort();
+	}
+}
+} // namespace Profile
+} // namespace Engine
+void* operator new(size_t size) {
+	return allocate(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+	return allocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+void operator delete(void* memory, std::align_val_t) noexcept {
+	std::free(memory);
+}
+#endif
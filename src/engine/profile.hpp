@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#ifdef PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+namespace Engine {
+// Instrumentation of the hot paths, compiled in only with PROFILE defined (make BUILD=profile). Every thread
+// keeps its own aggregates, they are merged into a report on stderr and in profile.json when the program exits.
+// With ALLOCATION_AUDIT defined (make BUILD=audit) the same phases count the heap allocations made inside them.
+namespace Profile {
+// Timed phases, nested phases are also counted in the phases around them. The phases up to node must never
+// allocate, an audit build aborts when they do.
+enum class Phase : uint8_t { available_moves, make_move, unmake_move, evaluate, node, search, get_move, render, count };
+// Sampled quantities, each sample also lands in a power of two histogram
+enum class Counter : uint8_t { moves_generated, nodes, count };
+#ifdef PROFILE
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+#endif
+}
+void record(Phase phase, uint64_t ticks);
+void add(Counter counter, uint64_t value);
+class Timer {
+	const Phase    m_phase;
+	const uint64_t m_start;
+
+public:
+	inline explicit Timer(Phase phase) : m_phase(phase), m_start(ticks()) {}
+	Timer(const Timer&) = delete;
+	inline ~Timer() {
+		record(m_phase, ticks() - m_start);
+	}
+};
+#endif
+#ifdef ALLOCATION_AUDIT
+// Heap allocations made by the calling thread so far
+uint64_t allocations();
+// Adds the allocations to the phase, aborts if the phase must not allocate
+void audit(Phase phase, uint64_t allocations);
+class Audit {
+	const Phase    m_phase;
+	const uint64_t m_start;
+
+public:
+	inline explicit Audit(Phase phase) : m_phase(phase), m_start(allocations()) {}
+	Audit(const Audit&) = delete;
+	inline ~Audit() {
+		audit(m_phase, allocations() - m_start);
+	}
+};
+#endif
+} // namespace Profile
+} // namespace Engine
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef PROFILE
+#define PROFILE_TIMER_(phase)                                                                                          \
+	const ::Engine::Profile::Timer PROFILE_CONCAT(profile_timer_, __LINE__) {                                            \
+		::Engine::Profile::Phase::phase                                                                                \
+	};
+#define PROFILE_ADD(counter, value) ::Engine::Profile::add(::Engine::Profile::Counter::counter, value)
+#else
+// Nothing is evaluated without PROFILE
+#define PROFILE_TIMER_(phase)
+#define PROFILE_ADD(counter, value) static_cast<void>(0)
+#endif
+#ifdef ALLOCATION_AUDIT
+#define PROFILE_AUDIT_(phase)                                                                                          \
+	const ::Engine::Profile::Audit PROFILE_CONCAT(profile_audit_, __LINE__) {                                            \
+		::Engine::Profile::Phase::phase                                                                                \
+	};
+#else
+#define PROFILE_AUDIT_(phase)
+#endif
+// Times the rest of the enclosing scope as the phase and audits its allocations, whichever is compiled in
+#define PROFILE_SCOPE(phase) PROFILE_TIMER_(phase) PROFILE_AUDIT_(phase) static_cast<void>(0)
@@ -0,0 +1,284 @@
+#include "engine.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+namespace Engine {
+namespace {
+constexpr char   magic[8]    = {'C', 'H', 'E', 'S', 'S', 'R', 'E', 'C'};
+constexpr size_t record_size = sizeof(PositionRecord);
+constexpr size_t flush_size  = 1 << 20;
+struct Header {
+	char     magic[8];
+	uint32_t record_size;
+	uint32_t block_size; // records per compressed block, 0 when the records follow uncompressed
+};
+// Every compressed block starts with its size, the encoded bytes follow
+struct BlockHeader {
+	uint32_t bytes;
+	uint32_t records;
+};
+// Control bytes of the encoding: below 0x80 that many plus one bytes follow as they are, from 0x80 on the low
+// seven bits plus one count zero bytes
+constexpr uint8_t zero_run = 0x80;
+// Stores every record as its xor with the one before, positions of a game differ in a few nibbles, so runs of
+// zero bytes make up most of the result
+void encode(const PositionRecord* records, size_t count, std::vector<char>& output) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(records);
+	const size_t         size  = count * record_size;
+	auto                 delta = [&](size_t i) -> unsigned char {
+		return i < record_size ? bytes[i] : bytes[i] ^ bytes[i - record_size];
+	};
+	for (size_t i = 0; i < size;) {
+		size_t run = i;
+		if (delta(i) == 0) {
+			while (run < size && run - i < 128 && delta(run) == 0)
+				run++;
+			output.push_back(static_cast<char>(zero_run | (run - i - 1)));
+		} else {
+			while (run < size && run - i < 128 && delta(run) != 0)
+				run++;
+			output.push_back(static_cast<char>(run - i - 1));
+			for (size_t j = i; j < run; j++)
+				output.push_back(static_cast<char>(delta(j)));
+		}
+		i = run;
+	}
+}
+// Returns false unless the bytes decode to exactly count records
+bool decode(const unsigned char* input, size_t length, PositionRecord* records, size_t count) {
+	unsigned char* bytes = reinterpret_cast<unsigned char*>(records);
+	const size_t   size  = count * record_size;
+	size_t         out   = 0;
+	for (size_t in = 0; in < length;) {
+		const uint8_t control = input[in++];
+		const size_t  run     = (control & ~zero_run) + 1;
+		if (out + run > size || ((control & zero_run) == 0 && in + run > length))
+			return false;
+		for (size_t j = 0; j < run; j++, out++) {
+			const unsigned char delta = ((control & zero_run) != 0 ? 0 : input[in++]);
+			bytes[out]                = (out < record_size ? delta : delta ^ bytes[out - record_size]);
+		}
+	}
+	return out == size;
+}
+void shuffle_range(size_t* first, size_t count, uint64_t& state) {
+	for (size_t i = count; i > 1; i--)
+		std::swap(first[i - 1], first[splitmix64(state) % i]);
+}
+} // namespace
+struct RecordWriter::State {
+	int                         file;
+	uint32_t                    block_size;
+	std::mutex                  mutex;
+	std::vector<PositionRecord> pending;       // records of the block being filled
+	std::vector<char>           buffer;        // bytes not written yet
+	bool                        failed{false}; // a write failed, records are missing from the file
+	void write_buffer() {
+		failed |= !write_all(file, buffer.data(), buffer.size());
+		buffer.clear();
+	}
+	// Moves the pending records into the buffer, a whole block at a time when compressing
+	void pack(bool partial) {
+		if (block_size == 0) {
+			const char* bytes = reinterpret_cast<const char*>(pending.data());
+			buffer.insert(buffer.end(), bytes, bytes + pending.size() * record_size);
+			pending.clear();
+			return;
+		}
+		size_t first = 0;
+		while (pending.size() - first >= block_size || (partial && first < pending.size())) {
+			const size_t count  = std::min<size_t>(block_size, pending.size() - first);
+			const size_t header = buffer.size();
+			buffer.resize(header + sizeof(BlockHeader));
+			encode(pending.data() + first, count, buffer);
+			const BlockHeader block{static_cast<uint32_t>(buffer.size() - header - sizeof(BlockHeader)),
+			                        static_cast<uint32_t>(count)};
+			std::memcpy(buffer.data() + header, &block, sizeof(block));
+			first += count;
+		}
+		pending.erase(pending.begin(), pending.begin() + first);
+	}
+};
+RecordWriter::~RecordWriter() {
+	close();
+}
+bool RecordWriter::open(const char* path, uint32_t block_size) {
+	close();
+	if (block_size > max_record_block_size)
+		return false;
+	const int file = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return false;
+	Header header;
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.record_size = record_size;
+	header.block_size  = block_size;
+	if (!write_all(file, reinterpret_cast<const char*>(&header), sizeof(header))) {
+		::close(file);
+		return false;
+	}
+	m_state             = new State;
+	m_state->file       = file;
+	m_state->block_size = block_size;
+	m_state->pending.reserve(block_size);
+	m_state->buffer.reserve(flush_size);
+	return true;
+}
+bool RecordWriter::close() {
+	if (m_state == nullptr)
+		return true;
+	{
+		std::lock_guard<std::mutex> lock{m_state->mutex};
+		m_state->pack(true);
+	}
+	const bool written = flush() && ::close(m_state->file) == 0;
+	delete m_state;
+	m_state = nullptr;
+	return written;
+}
+void RecordWriter::write(const PositionRecord* records, size_t count) {
+	if (m_state == nullptr)
+		return;
+	std::lock_guard<std::mutex> lock{m_state->mutex};
+	m_state->pending.insert(m_state->pending.end(), records, records + count);
+	m_state->pack(false);
+	if (m_state->buffer.size() >= flush_size)
+		m_state->write_buffer();
+}
+bool RecordWriter::flush() {
+	if (m_state == nullptr)
+		return true;
+	std::lock_guard<std::mutex> lock{m_state->mutex};
+	m_state->write_buffer();
+	return !m_state->failed;
+}
+RecordFile::~RecordFile() {
+	close();
+}
+bool RecordFile::open(const char* path) {
+	close();
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+		::close(file);
+		return false;
+	}
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapping == MAP_FAILED)
+		return false;
+	m_data = static_cast<const unsigned char*>(mapping);
+	m_size = status.st_size;
+	Header header;
+	std::memcpy(&header, m_data, sizeof(header));
+	if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.record_size != record_size) {
+		close();
+		return false;
+	}
+	m_compressed = (header.block_size != 0);
+	if (!m_compressed) {
+		if ((m_size - sizeof(Header)) % record_size != 0) {
+			close();
+			return false;
+		}
+		m_records = (m_size - sizeof(Header)) / record_size;
+		return true;
+	}
+	if (header.block_size > max_record_block_size) {
+		close();
+		return false;
+	}
+	// Only the last block may be partial, so a block index finds its block without a search
+	m_block_size = header.block_size;
+	size_t largest = 0;
+	for (size_t offset = sizeof(Header); offset < m_size;) {
+		BlockHeader block;
+		if (m_size - offset < sizeof(block)) {
+			close();
+			return false;
+		}
+		std::memcpy(&block, m_data + offset, sizeof(block));
+		if (block.records == 0 || block.records > m_block_size || block.bytes > m_size - offset - sizeof(block)
+		    || (!m_blocks.empty() && m_records % m_block_size != 0)) {
+			close();
+			return false;
+		}
+		m_blocks.push_back(offset);
+		m_records += block.records;
+		largest = std::max<size_t>(largest, block.records);
+		offset += sizeof(block) + block.bytes;
+	}
+	m_decoded.resize(largest);
+	return true;
+}
+void RecordFile::close() {
+	if (m_data != nullptr)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	m_data       = nullptr;
+	m_size       = 0;
+	m_records    = 0;
+	m_block_size = record_block_size;
+	m_compressed = false;
+	m_blocks.clear();
+	m_decoded.clear();
+	m_decoded_size = 0;
+}
+const PositionRecord* RecordFile::block(size_t index, size_t& count) {
+	count = 0;
+	if (index >= blocks())
+		return nullptr;
+	if (!m_compressed) {
+		count = std::min<size_t>(m_block_size, m_records - index * m_block_size);
+		return reinterpret_cast<const PositionRecord*>(m_data + sizeof(Header)) + index * m_block_size;
+	}
+	if (m_decoded_size == 0 || m_decoded_block != index) {
+		BlockHeader block;
+		std::memcpy(&block, m_data + m_blocks[index], sizeof(block));
+		m_decoded_size = 0;
+		if (!decode(m_data + m_blocks[index] + sizeof(block), block.bytes, m_decoded.data(), block.records))
+			return nullptr;
+		m_decoded_block = index;
+		m_decoded_size  = block.records;
+	}
+	count = m_decoded_size;
+	return m_decoded.data();
+}
+bool RecordFile::read(size_t index, PositionRecord& record) {
+	size_t                      count;
+	const PositionRecord* const records = block(index / m_block_size, count);
+	if (records == nullptr || index % m_block_size >= count)
+		return false;
+	record = records[index % m_block_size];
+	return true;
+}
+void RecordFile::shuffle(uint64_t seed, std::vector<size_t>& order) const {
+	order.resize(m_records);
+	uint64_t state = seed;
+	if (!m_compressed) {
+		for (size_t i = 0; i < m_records; i++)
+			order[i] = i;
+		shuffle_range(order.data(), m_records, state);
+		return;
+	}
+	std::vector<size_t> blocks(this->blocks());
+	for (size_t i = 0; i < blocks.size(); i++)
+		blocks[i] = i;
+	shuffle_range(blocks.data(), blocks.size(), state);
+	size_t next = 0;
+	for (size_t index: blocks) {
+		const size_t first = index * m_block_size;
+		const size_t count = std::min<size_t>(m_block_size, m_records - first);
+		for (size_t i = 0; i < count; i++)
+			order[next + i] = first + i;
+		shuffle_range(order.data() + next, count, state);
+		next += count;
+	}
+}
+} // namespace Engine
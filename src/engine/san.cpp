@@ -0,0 +1,114 @@
+#include "engine.hpp"
+#include <cstring>
+namespace Engine {
+namespace {
+constexpr char piece_letters[6] = {'P', 'N', 'B', 'R', 'Q', 'K'};
+PieceType letter_type(char letter) {
+	switch (letter) {
+	case 'N': return PieceType::knight;
+	case 'B': return PieceType::bishop;
+	case 'R': return PieceType::rook;
+	case 'Q': return PieceType::queen;
+	case 'K': return PieceType::king;
+	default: return PieceType::empty;
+	}
+}
+// Kings move two files only when castling, toward file G on the king side
+bool is_castling(PieceType type, Move move) {
+	return type == PieceType::king && (move.from() % 8 - move.to() % 8 == 2 || move.to() % 8 - move.from() % 8 == 2);
+}
+char* write_square(uint8_t index, char* san) {
+	*san++ = 'h' - index % 8;
+	*san++ = '8' - index / 8;
+	return san;
+}
+} // namespace
+char* write_san(const Board& board, Color turn, Move move, char* san) {
+	const PieceType type = piece_type(board.get_piece(move.from()));
+	if (is_castling(type, move)) {
+		std::memcpy(san, "O-O-O", 5);
+		san += (move.to() % 8 < move.from() % 8 ? 3 : 5);
+	} else {
+		const bool capture = move.is_capture(board);
+		if (type == PieceType::pawn) {
+			if (capture)
+				*san++ = 'h' - move.from() % 8;
+		} else {
+			*san++ = piece_letters[static_cast<uint8_t>(type)];
+			// Name the file of the origin, or the rank when the file is shared, or both
+			bool ambiguous = false, same_file = false, same_rank = false;
+			for (Move other: AvailableMoves{board, turn}) {
+				if (other.to() != move.to() || other.from() == move.from()
+				    || piece_type(board.get_piece(other.from())) != type)
+					continue;
+				ambiguous = true;
+				same_file |= other.from() % 8 == move.from() % 8;
+				same_rank |= other.from() / 8 == move.from() / 8;
+			}
+			if (ambiguous && (!same_file || same_rank))
+				*san++ = 'h' - move.from() % 8;
+			if (ambiguous && same_file)
+				*san++ = '8' - move.from() / 8;
+		}
+		if (capture)
+			*san++ = 'x';
+		san = write_square(move.to(), san);
+		if (move.is_promotion()) {
+			*san++ = '=';
+			*san++ = piece_letters[static_cast<uint8_t>(move.promotion())];
+		}
+	}
+	Board copy{board};
+	copy.make_move(move);
+	const AvailableMoves replies{copy, turn == Color::white ? Color::black : Color::white};
+	if (replies.in_check())
+		*san++ = (replies.count() == 0 ? '#' : '+');
+	*san = '\0';
+	return san;
+}
+Move parse_san(const Board& board, const AvailableMoves& available, const char* san, size_t length) {
+	while (length > 0 && std::strchr("+#!?", san[length - 1]) != nullptr && san[length - 1] != '\0')
+		length--;
+	// Castling is written with letters or with zeros
+	if (length == 3 || length == 5) {
+		if ((std::strncmp(san, "O-O-O", length) == 0 || std::strncmp(san, "0-0-0", length) == 0)) {
+			for (Move move: available) {
+				const PieceType type = piece_type(board.get_piece(move.from()));
+				if (is_castling(type, move) && (move.to() % 8 < move.from() % 8) == (length == 3))
+					return move;
+			}
+			return Move{};
+		}
+	}
+	PieceType promotion = PieceType::empty;
+	if (length >= 3 && letter_type(san[length - 1]) != PieceType::empty && san[length - 1] != 'K') {
+		promotion = letter_type(san[length - 1]);
+		length -= (san[length - 2] == '=' ? 2 : 1);
+	}
+	if (length < 2 || san[length - 2] < 'a' || san[length - 2] > 'h' || san[length - 1] < '1' || san[length - 1] > '8')
+		return Move{};
+	const uint8_t   to    = 8 * ('8' - san[length - 1]) + ('h' - san[length - 2]);
+	const PieceType type  = letter_type(san[0]);
+	const PieceType moved = (type == PieceType::empty ? PieceType::pawn : type);
+	// Whatever is left between the piece and the destination narrows down the origin
+	int8_t file = -1, rank = -1;
+	for (size_t i = (type == PieceType::empty ? 0 : 1); i + 2 < length; i++) {
+		if (san[i] >= 'a' && san[i] <= 'h')
+			file = 'h' - san[i];
+		else if (san[i] >= '1' && san[i] <= '8')
+			rank = '8' - san[i];
+		else if (san[i] != 'x' && san[i] != '-' && san[i] != ':')
+			return Move{};
+	}
+	Move    result{};
+	uint8_t matches = 0;
+	for (Move move: available) {
+		if (move.to() != to || move.promotion() != promotion || piece_type(board.get_piece(move.from())) != moved
+		    || (file >= 0 && move.from() % 8 != file) || (rank >= 0 && move.from() / 8 != rank))
+			continue;
+		result = move;
+		matches++;
+	}
+	return matches == 1 ? result : Move{};
+}
+} // namespace Engine
@@ -0,0 +1,463 @@
+#include "attacks.hpp"
+#include "engine.hpp"
+#include "profile.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+namespace Engine {
+namespace {
+constexpr uint8_t max_ply  = 128;
+constexpr int16_t infinity = 32767;
+static_assert(max_ply + UINT8_MAX < mate_window, "tablebase mates found at the deepest ply leave the mate window");
+// Most valuable victim, least valuable attacker, indexed by PieceType
+constexpr int32_t exchange_values[8] = {1, 3, 3, 5, 9, 20, 1, 0};
+Color opponent(Color color) {
+	return color == Color::white ? Color::black : Color::white;
+}
+// Mate scores are stored relative to the node so they stay valid when reached at another ply
+int16_t score_to_table(int16_t score, uint8_t ply) {
+	if (score >= search_mate - mate_window)
+		return score + ply;
+	if (score <= -search_mate + mate_window)
+		return score - ply;
+	return score;
+}
+int16_t score_from_table(int16_t score, uint8_t ply) {
+	if (score >= search_mate - mate_window)
+		return score - ply;
+	if (score <= -search_mate + mate_window)
+		return score + ply;
+	return score;
+}
+struct ScoredMove {
+	Move    move;
+	int32_t score;
+};
+// State shared by every thread of one search
+struct SharedSearch {
+	const SearchLimits&                         limits;
+	SearchListener*                             listener;
+	const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+	std::atomic<bool>                           stop{false};
+	std::atomic<uint64_t>                       nodes{0};
+	// The time limit counts from the start, or from the ponderhit when the search began pondering
+	std::atomic<std::chrono::steady_clock::rep> clock{start.time_since_epoch().count()};
+	std::atomic<bool>                           pondering{limits.ponder != nullptr && limits.ponder->load()};
+	SharedSearch(const SearchLimits& limits, SearchListener* listener) : limits(limits), listener(listener) {}
+	// The time limit is ignored while pondering
+	bool timed() {
+		if (pondering.load()) {
+			if (limits.ponder->load(std::memory_order_relaxed))
+				return false;
+			clock.store(std::chrono::steady_clock::now().time_since_epoch().count());
+			pondering.store(false);
+		}
+		return limits.milliseconds != 0;
+	}
+	uint32_t elapsed() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+	// Milliseconds counted against the time limit
+	uint32_t used() const {
+		const std::chrono::steady_clock::duration since{std::chrono::steady_clock::now().time_since_epoch().count()
+		                                                - clock.load()};
+		return std::chrono::duration_cast<std::chrono::milliseconds>(since).count();
+	}
+};
+class Searcher {
+	Board&              m_board;
+	TranspositionTable& m_table;
+	SharedSearch&       m_shared;
+	const SearchLimits& m_limits;
+	const uint8_t       m_thread; // 0 is the main thread, the others are helpers
+	uint64_t            m_nodes{0};
+	uint64_t            m_reported{0}; // nodes already added to the shared count
+	bool                m_stopped{false};
+	Move                m_root_move{};
+	Move                m_killers[max_ply][2]{};
+	int32_t             m_history[2][64][64]{};
+	uint64_t            m_path[max_ply + 1]{}; // hashes of the current line
+
+public:
+	Searcher(Board& board, TranspositionTable& table, SharedSearch& shared, uint8_t thread) :
+	    m_board(board), m_table(table), m_shared(shared), m_limits(shared.limits), m_thread(thread) {}
+	uint64_t nodes() const {
+		return m_nodes;
+	}
+
+private:
+	// Threads publish their node counts in batches so the shared counter is not contended on every node
+	void check_limits() {
+		if ((m_nodes & 0x3FF) == 0) {
+			const uint64_t total = m_shared.nodes.fetch_add(m_nodes - m_reported, std::memory_order_relaxed) + m_nodes - m_reported;
+			m_reported           = m_nodes;
+			if (m_thread == 0
+			    && ((m_limits.nodes != 0 && total >= m_limits.nodes)
+			        || (m_shared.timed() && m_shared.used() >= m_limits.milliseconds)))
+				m_shared.stop.store(true, std::memory_order_relaxed);
+		}
+		// An outside request to stop is checked on every node, it has to be answered quickly
+		if (m_thread == 0 && m_limits.stop != nullptr && m_limits.stop->load(std::memory_order_relaxed))
+			m_shared.stop.store(true, std::memory_order_relaxed);
+		if (m_shared.stop.load(std::memory_order_relaxed))
+			m_stopped = true;
+	}
+	bool is_tactical(Move move) const {
+		return move.is_capture(m_board) || move.promotion() == PieceType::queen;
+	}
+	int32_t order(Move move, Color color, Move hash_move, uint8_t ply) const {
+		if (move == hash_move)
+			return 1 << 30;
+		const Piece moved = m_board.get_piece(move.from());
+		if (is_tactical(move)) {
+			const PieceType victim    = piece_type(m_board.get_piece(move.to()));
+			const PieceType promotion = move.promotion();
+			return (1 << 24) + 16 * (exchange_values[static_cast<uint8_t>(victim)] + (promotion == PieceType::queen ? 8 : 0))
+			       - exchange_values[static_cast<uint8_t>(piece_type(moved))];
+		}
+		if (move == m_killers[ply][0])
+			return 1 << 22;
+		if (move == m_killers[ply][1])
+			return 1 << 21;
+		if (move.is_promotion())
+			return -(1 << 20);
+		return m_history[static_cast<uint8_t>(color)][move.from()][move.to()];
+	}
+	// Underpromotions, and captures of a cheaper piece on a defended square, are tried after the quiet moves
+	bool losing(Move move, Color color) const {
+		if (move.is_promotion())
+			return move.promotion() != PieceType::queen;
+		const uint8_t attacker = exchange_values[static_cast<uint8_t>(piece_type(m_board.get_piece(move.from())))];
+		const uint8_t victim   = exchange_values[static_cast<uint8_t>(piece_type(m_board.get_piece(move.to())))];
+		return victim < attacker
+		       && attackers(m_board, move.to(), opponent(color), m_board.occupied() ^ bit(move.from())) != 0;
+	}
+	// Selection sort step, moves are usually cut off long before the list is sorted
+	static Move pick(ScoredMove* list, uint16_t index, uint16_t end) {
+		uint16_t best = index;
+		for (uint16_t i = index + 1; i < end; i++) {
+			if (list[i].score > list[best].score)
+				best = i;
+		}
+		const ScoredMove chosen = list[best];
+		list[best]              = list[index];
+		list[index]             = chosen;
+		return chosen.move;
+	}
+	// Hands out the moves of a node in stages, each generated only once the stages before it ran out: the hash
+	// move, winning tactical moves, killers and quiet moves by history, then losing captures and underpromotions.
+	// In check every evasion is generated at once.
+	class MovePicker {
+		enum class Stage : uint8_t { hash, tactical, good, quiet, bad, evasions, done };
+		const Searcher& m_searcher;
+		const Color     m_color;
+		const Move      m_hash_move;
+		const uint8_t   m_ply;
+		const bool      m_tactical_only; // quiescence, no quiet moves and no quiet underpromotions
+		bool            m_check;
+		Stage           m_stage;
+		ScoredMove      m_list[256];
+		uint16_t        m_index{0};
+		uint16_t        m_end{0};   // moves of the current stage are between m_index and m_end
+		uint16_t        m_bad{256}; // losing tactical moves are kept at the back of the list until their stage
+
+	public:
+		MovePicker(const Searcher& searcher, Color color, Move hash_move, uint8_t ply, bool tactical_only) :
+		    m_searcher(searcher), m_color(color), m_hash_move(hash_move), m_ply(ply), m_tactical_only(tactical_only) {
+			const Board&   board = searcher.m_board;
+			const uint64_t kings = board.pieces(color, PieceType::king);
+			m_check = kings != 0 && attackers(board, lowest_bit(kings), opponent(color), board.occupied()) != 0;
+			if (m_check) {
+				generate(MoveKind::all);
+				m_stage = Stage::evasions;
+			} else
+				m_stage = (hash_move != Move{} && !tactical_only ? Stage::hash : Stage::tactical);
+		}
+		MovePicker(const MovePicker&) = delete;
+		inline bool in_check() const {
+			return m_check;
+		}
+		// The null move once every stage is exhausted
+		Move next() {
+			while (true) {
+				switch (m_stage) {
+				case Stage::hash:
+					m_stage = Stage::tactical;
+					// Table moves may come from another position with the same slot, only a legal one is played
+					if (AvailableMoves{m_searcher.m_board, m_color, MoveKind::all, bit(m_hash_move.from())}.move_possible(
+					        m_hash_move))
+						return m_hash_move;
+					break;
+				case Stage::tactical:
+					generate(MoveKind::tactical);
+					m_stage = Stage::good;
+					break;
+				case Stage::good:
+					if (m_index < m_end)
+						return pick(m_list, m_index++, m_end);
+					if (!m_tactical_only)
+						generate(MoveKind::quiet);
+					m_stage = (m_tactical_only ? Stage::bad : Stage::quiet);
+					break;
+				case Stage::quiet:
+					if (m_index < m_end)
+						return pick(m_list, m_index++, m_end);
+					m_stage = Stage::bad;
+					break;
+				case Stage::bad:
+					if (m_bad < 256)
+						return pick(m_list, m_bad++, 256);
+					m_stage = Stage::done;
+					break;
+				case Stage::evasions:
+					if (m_index < m_end)
+						return pick(m_list, m_index++, m_end);
+					m_stage = Stage::done;
+					break;
+				case Stage::done: return Move{};
+				}
+			}
+		}
+
+	private:
+		// Replaces the front of the list with the moves of the kind, the hash move was already tried
+		void generate(MoveKind kind) {
+			m_index = 0;
+			m_end   = 0;
+			for (Move move: AvailableMoves{m_searcher.m_board, m_color, kind}) {
+				if (move == m_hash_move && kind != MoveKind::all)
+					continue;
+				const ScoredMove scored = {move, m_searcher.order(move, m_color, m_hash_move, m_ply)};
+				if (kind != MoveKind::tactical || !m_searcher.losing(move, m_color))
+					m_list[m_end++] = scored;
+				else if (!m_tactical_only || move.is_capture(m_searcher.m_board))
+					m_list[--m_bad] = scored;
+			}
+		}
+	};
+	// Quiet moves that cut off are tried earlier elsewhere, the table is halved before it reaches the killers
+	void reward(Color color, uint8_t from, uint8_t to, int8_t depth) {
+		int32_t& entry = m_history[static_cast<uint8_t>(color)][from][to];
+		entry += depth * depth;
+		if (entry < (1 << 20))
+			return;
+		for (auto& side: m_history) {
+			for (auto& row: side) {
+				for (int32_t& value: row)
+					value /= 2;
+			}
+		}
+	}
+	// Against the line from the root, then against the game before the root
+	bool repeated(uint8_t ply) const {
+		int16_t i = ply - 2;
+		for (; i >= 0; i -= 2) {
+			if (m_path[i] == m_path[ply])
+				return true;
+		}
+		if (m_limits.history == nullptr)
+			return false;
+		// The root is the last entry, so the position i plies before it is at the end minus i
+		const std::vector<uint64_t>& game = *m_limits.history;
+		for (int32_t j = static_cast<int32_t>(game.size()) - 1 + i; j >= 0; j -= 2) {
+			if (game[j] == m_path[ply])
+				return true;
+		}
+		return false;
+	}
+	int16_t quiescence(Color color, int16_t alpha, int16_t beta, uint8_t ply) {
+		PROFILE_SCOPE(node);
+		m_nodes++;
+		check_limits();
+		if (m_stopped)
+			return 0;
+		if (ply >= max_ply)
+			return evaluate(m_board, color);
+		MovePicker picker{*this, color, Move{}, ply, true};
+		// In check every evasion is searched, otherwise the side to move may stand pat
+		int16_t best = -infinity;
+		if (!picker.in_check()) {
+			best = evaluate(m_board, color);
+			if (best >= beta)
+				return best;
+			if (best > alpha)
+				alpha = best;
+		}
+		for (Move move = picker.next(); move != Move{}; move = picker.next()) {
+			const Undo    undo  = m_board.make_move(move);
+			const int16_t score = -quiescence(opponent(color), -beta, -alpha, ply + 1);
+			m_board.unmake_move(move, undo);
+			if (m_stopped)
+				return 0;
+			if (score > best) {
+				best = score;
+				if (score > alpha)
+					alpha = score;
+				if (score >= beta)
+					break;
+			}
+		}
+		// Checkmated when no evasion was found
+		return best == -infinity ? -search_mate + ply : best;
+	}
+	int16_t alpha_beta(Color color, int16_t alpha, int16_t beta, int8_t depth, uint8_t ply) {
+		PROFILE_SCOPE(node);
+		m_path[ply] = m_board.hash();
+		if (ply > 0 && repeated(ply))
+			return 0;
+		// The tablebases know the exact distance to mate, scored like a mate found by the search
+		TablebaseEntry ending;
+		if (ply > 0 && m_limits.tablebases != nullptr && m_limits.tablebases->probe(m_board, color, ending)) {
+			m_nodes++;
+			if (ending.wdl == 0)
+				return 0;
+			return ending.wdl > 0 ? search_mate - ply - ending.plies : -search_mate + ply + ending.plies;
+		}
+		if (depth <= 0 || ply >= max_ply)
+			return quiescence(color, alpha, beta, ply);
+		m_nodes++;
+		check_limits();
+		if (m_stopped)
+			return 0;
+		const bool                pv_node = beta - alpha > 1;
+		TranspositionTable::Entry entry;
+		Move                      hash_move{};
+		if (m_table.probe(m_board.hash(), entry)) {
+			hash_move           = Move::from_data(entry.move);
+			const int16_t score = score_from_table(entry.score, ply);
+			if (ply > 0 && !pv_node && entry.depth >= depth
+			    && (entry.bound == TranspositionTable::Bound::exact
+			        || (entry.bound == TranspositionTable::Bound::lower && score >= beta)
+			        || (entry.bound == TranspositionTable::Bound::upper && score <= alpha)))
+				return score;
+		}
+		MovePicker picker{*this, color, hash_move, ply, false};
+		if (picker.in_check())
+			depth++;
+		const int16_t alpha_start = alpha;
+		int16_t       best        = -infinity;
+		uint8_t       searched    = 0;
+		Move          best_move{};
+		for (Move move = picker.next(); move != Move{}; move = picker.next()) {
+			const bool    tactical = is_tactical(move);
+			const Undo    undo     = m_board.make_move(move);
+			int16_t       score;
+			if (searched++ == 0)
+				score = -alpha_beta(opponent(color), -beta, -alpha, depth - 1, ply + 1);
+			else {
+				// Later moves only have to be proven worse, a null window search is enough unless they are not
+				score = -alpha_beta(opponent(color), -alpha - 1, -alpha, depth - 1, ply + 1);
+				if (score > alpha && score < beta)
+					score = -alpha_beta(opponent(color), -beta, -alpha, depth - 1, ply + 1);
+			}
+			m_board.unmake_move(move, undo);
+			if (m_stopped)
+				return 0;
+			if (score <= best)
+				continue;
+			best      = score;
+			best_move = move;
+			if (ply == 0)
+				m_root_move = move;
+			if (score <= alpha)
+				continue;
+			alpha = score;
+			if (alpha < beta)
+				continue;
+			if (!tactical) {
+				if (m_killers[ply][0] != move) {
+					m_killers[ply][1] = m_killers[ply][0];
+					m_killers[ply][0] = move;
+				}
+				reward(color, move.from(), move.to(), depth);
+			}
+			break;
+		}
+		if (searched == 0)
+			return picker.in_check() ? -search_mate + ply : 0;
+		TranspositionTable::Entry result;
+		result.move  = best_move.data();
+		result.score = score_to_table(best, ply);
+		result.depth = depth;
+		result.bound = (best >= beta          ? TranspositionTable::Bound::lower
+		                : best > alpha_start ? TranspositionTable::Bound::exact
+		                                     : TranspositionTable::Bound::upper);
+		m_table.store(m_board.hash(), result);
+		return best;
+	}
+
+public:
+	SearchInfo iterate(Color color) {
+		SearchInfo info;
+		for (Move move: AvailableMoves{m_board, color}) {
+			info.move = move;
+			break;
+		}
+		// Helpers start half of them one ply deeper so the threads do not all walk the same tree in step
+		for (uint8_t depth = 1 + m_thread % 2; depth <= m_limits.depth && depth < max_ply; depth++) {
+			const int16_t score = alpha_beta(color, -infinity, infinity, depth, 0);
+			if (m_stopped)
+				break;
+			info.move  = m_root_move;
+			info.score = score;
+			info.depth = depth;
+			if (m_thread == 0 && m_shared.listener != nullptr) {
+				info.nodes        = m_shared.nodes.load(std::memory_order_relaxed) + m_nodes - m_reported;
+				info.milliseconds = m_shared.elapsed();
+				m_shared.listener->iteration(info);
+			}
+			// The next iteration takes several times as long, it would not finish in the time left
+			if (m_shared.timed() && m_shared.used() * 2 >= m_limits.milliseconds)
+				break;
+			if (score >= search_mate - depth || score <= -search_mate + depth)
+				break;
+		}
+		info.nodes        = m_nodes;
+		info.milliseconds = m_shared.elapsed();
+		return info;
+	}
+};
+} // namespace
+SearchInfo search(Board& board, Color color, TranspositionTable& table, const SearchLimits& limits,
+                  SearchListener* listener) {
+	PROFILE_SCOPE(search);
+	SharedSearch shared{limits, listener};
+	table.new_search();
+	// Lazy SMP: helpers search the same root on their own boards and stacks, sharing only the table
+	const uint8_t            threads = (limits.threads == 0 ? 1 : limits.threads);
+	std::vector<uint64_t>    helper_nodes(threads, 0);
+	std::vector<std::thread> helpers;
+	// Copied before any thread starts, the main search makes its moves on board right away
+	std::vector<Board> boards(threads - 1, board);
+	for (uint8_t i = 1; i < threads; i++) {
+		helpers.emplace_back([&, i]() {
+			Searcher searcher{boards[i - 1], table, shared, i};
+			searcher.iterate(color);
+			helper_nodes[i] = searcher.nodes();
+		});
+	}
+	Searcher   searcher{board, table, shared, 0};
+	SearchInfo info = searcher.iterate(color);
+	shared.stop.store(true, std::memory_order_relaxed);
+	for (std::thread& helper: helpers)
+		helper.join();
+	info.thread_nodes    = helper_nodes;
+	info.thread_nodes[0] = info.nodes;
+	for (uint8_t i = 1; i < threads; i++)
+		info.nodes += helper_nodes[i];
+	info.milliseconds = shared.elapsed();
+	PROFILE_ADD(nodes, info.nodes);
+	return info;
+}
+SearchPlayer::SearchPlayer(const SearchLimits& limits, size_t hash_megabytes) :
+    m_table(hash_megabytes), m_limits(limits) {}
+Move SearchPlayer::get_move(const Game& game, const AvailableMoves& available) {
+	Board        board{game.get_board()};
+	SearchLimits limits = m_limits;
+	limits.history      = &game.get_history();
+	return search(board, game.get_player(), m_table, limits).move;
+}
+void SearchPlayer::new_game() {
+	m_table.clear();
+}
+} // namespace Engine
@@ -0,0 +1,168 @@
+#include "engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+namespace Engine {
+namespace {
+// Hands the opening plies to a random player so that games between deterministic players differ
+class OpeningPlayer : public Player {
+	Player&  m_random;
+	Player&  m_player;
+	uint16_t m_plies;
+
+public:
+	OpeningPlayer(Player& random, Player& player, uint16_t plies) : m_random(random), m_player(player), m_plies(plies) {}
+	Move get_move(const Game& game, const AvailableMoves& available) override {
+		if (game.get_turn_number() < m_plies)
+			return m_random.get_move(game, available);
+		return m_player.get_move(game, available);
+	}
+};
+const char* player_name(PlayerType type) {
+	return type == PlayerType::random ? "random" : "search";
+}
+// Where a worker writes its games, the game record and the positions keep their memory from game to game
+struct Outputs {
+	PgnWriter*                  pgn{nullptr};
+	RecordWriter*               records{nullptr};
+	PgnRecord                   game{};
+	std::vector<PositionRecord> positions{};
+};
+void play_game(const SelfPlaySettings& settings, uint32_t index, Player* searchers[2], const PolyglotBook& book,
+               const Tablebases& tablebases, Outputs& outputs, SelfPlayReport& report) {
+	const uint64_t   seed     = settings.seed + index;
+	const PlayerType types[2] = {settings.white, settings.black};
+	RandomPlayer     random[2]{RandomPlayer(seed * 2), RandomPlayer(seed * 2 + 1)};
+	Player*          players[2];
+	for (uint8_t i = 0; i < 2; i++) {
+		players[i] = (types[i] == PlayerType::random ? static_cast<Player*>(&random[i]) : searchers[i]);
+		players[i]->new_game();
+	}
+	// The book takes over after the random plies while the game stays in it, an empty book passes every move on
+	BookPlayer    books[2]{BookPlayer(book, *players[0], ~seed * 2), BookPlayer(book, *players[1], ~seed * 2 + 1)};
+	OpeningPlayer white{random[0], books[0], settings.random_plies};
+	OpeningPlayer black{random[1], books[1], settings.random_plies};
+	Game          game{&white, &black};
+	if (outputs.pgn != nullptr)
+		game.record(&outputs.game);
+	outputs.positions.clear();
+	// Once the tablebases hold the position the game is scored as they say
+	TablebaseEntry ending;
+	bool           adjudicated = false;
+	while (game.get_termination() == Termination::none && game.get_turn_number() < settings.max_plies) {
+		adjudicated = tablebases.probe(game.get_board(), game.get_player(), ending);
+		if (adjudicated)
+			break;
+		if (outputs.records == nullptr) {
+			game.advance_turn();
+			continue;
+		}
+		PositionRecord position;
+		std::memcpy(position.board, game.get_board().data(), sizeof(position.board));
+		position.score = evaluate(game.get_board(), game.get_player());
+		position.ply   = game.get_turn_number();
+		position.turn  = game.get_player();
+		game.advance_turn();
+		// The final position has no move played from it
+		if (game.get_turn_number() == position.ply)
+			continue;
+		position.move = game.get_last_move().data();
+		outputs.positions.push_back(position);
+	}
+	GameResult result = game.get_result();
+	if (adjudicated && ending.wdl != 0)
+		result = ((ending.wdl > 0) == (game.get_player() == Color::white) ? GameResult::white_wins : GameResult::black_wins);
+	else if (result == GameResult::unknown)
+		result = GameResult::draw;
+	if (outputs.records != nullptr) {
+		for (PositionRecord& position: outputs.positions)
+			position.result = result;
+		outputs.records->write(outputs.positions.data(), outputs.positions.size());
+	}
+	if (outputs.pgn != nullptr) {
+		PgnTags tags;
+		tags.event = "self-play";
+		tags.white = player_name(settings.white);
+		tags.black = player_name(settings.black);
+		tags.round = index + 1;
+		outputs.pgn->write(outputs.game, result, tags);
+	}
+	report.games++;
+	report.plies += game.get_turn_number();
+	if (adjudicated)
+		report.tablebase++;
+	else
+		report.terminations[static_cast<uint8_t>(game.get_termination())]++;
+	switch (result) {
+	case GameResult::white_wins: report.white_wins++; break;
+	case GameResult::black_wins: report.black_wins++; break;
+	default: report.draws++; break;
+	}
+}
+} // namespace
+SelfPlayReport self_play(const SelfPlaySettings& settings) {
+	const auto                  start   = std::chrono::steady_clock::now();
+	const uint8_t               threads = (settings.threads == 0 ? 1 : settings.threads);
+	std::atomic<uint32_t>       next{0};
+	std::vector<SelfPlayReport> reports(threads);
+	std::vector<std::thread>    workers;
+	PgnWriter                   writer;
+	if (settings.pgn != nullptr && !writer.open(settings.pgn))
+		fprintf(stderr, "cannot write %s\n", settings.pgn);
+	RecordWriter records;
+	if (settings.records != nullptr && !records.open(settings.records))
+		fprintf(stderr, "cannot write %s\n", settings.records);
+	PgnWriter* const    pgn    = (settings.pgn != nullptr ? &writer : nullptr);
+	RecordWriter* const record = (settings.records != nullptr ? &records : nullptr);
+	// One mapping serves every game
+	PolyglotBook book;
+	if (settings.book != nullptr && !book.open(settings.book))
+		fprintf(stderr, "cannot read %s\n", settings.book);
+	Tablebases tablebases;
+	if (settings.tablebases != nullptr && !tablebases.open(settings.tablebases))
+		fprintf(stderr, "cannot read %s\n", settings.tablebases);
+	SearchLimits limits = settings.limits;
+	if (tablebases.size() != 0)
+		limits.tablebases = &tablebases;
+	for (uint8_t i = 0; i < threads; i++) {
+		workers.emplace_back([&, i]() {
+			// Search players keep their table for the whole worker and clear it between games
+			std::unique_ptr<Player> searchers[2];
+			Player*                 players[2]{};
+			const PlayerType        types[2] = {settings.white, settings.black};
+			Outputs                 outputs;
+			outputs.pgn     = pgn;
+			outputs.records = record;
+			for (uint8_t side = 0; side < 2; side++) {
+				if (types[side] == PlayerType::search)
+					searchers[side].reset(new SearchPlayer(limits, settings.hash_megabytes));
+				players[side] = searchers[side].get();
+			}
+			for (uint32_t game = next++; game < settings.games; game = next++)
+				play_game(settings, game, players, book, tablebases, outputs, reports[i]);
+		});
+	}
+	for (std::thread& worker: workers)
+		worker.join();
+	if (!writer.close())
+		fprintf(stderr, "cannot write all games to %s\n", settings.pgn);
+	if (!records.close())
+		fprintf(stderr, "cannot write all records to %s\n", settings.records);
+	SelfPlayReport result;
+	for (const SelfPlayReport& report: reports) {
+		result.games += report.games;
+		result.plies += report.plies;
+		result.white_wins += report.white_wins;
+		result.black_wins += report.black_wins;
+		result.draws += report.draws;
+		result.tablebase += report.tablebase;
+		for (uint8_t i = 0; i < 6; i++)
+			result.terminations[i] += report.terminations[i];
+	}
+	result.milliseconds =
+	    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+} // namespace Engine
@@ -0,0 +1,558 @@
+#include "attacks.hpp"
+#include "engine.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+namespace Engine {
+namespace {
+constexpr char magic[8] = {'C', 'P', 'P', 'T', 'B', '\0', '\0', '\1'};
+// Fixed size start of a table file, the packed values follow as little endian 64-bit words
+struct Header {
+	char     magic[8];
+	char     material[16];
+	uint64_t positions;
+	uint8_t  bits; // per position
+	uint8_t  reserved[31];
+};
+static_assert(sizeof(Header) == 64, "the values start on a cache line");
+// Stored values: 0 draw, 1 not a legal position, otherwise the plies to mate plus 2. Mates always take an odd
+// number of plies, so the side to move wins exactly when the distance is odd.
+constexpr uint8_t draw    = 0;
+constexpr uint8_t illegal = 1;
+constexpr uint8_t decided(uint16_t plies) {
+	return plies + 2;
+}
+constexpr uint16_t max_plies = 253;
+// Marks positions whose moves all stay in the table, no move leads to an illegal position
+constexpr uint8_t no_exit = illegal;
+// Letters of a side from the strongest piece down, the king is implied
+constexpr char      letters[6] = "QRBNP"; // terminated for strchr
+constexpr PieceType types[5]   = {PieceType::queen, PieceType::rook, PieceType::bishop, PieceType::knight, PieceType::pawn};
+Color opponent(Color color) {
+	return color == Color::white ? Color::black : Color::white;
+}
+// Stronger sides have more pieces, or stronger ones from the top down
+bool stronger(const std::string& side, const std::string& other) {
+	if (side.size() != other.size())
+		return side.size() > other.size();
+	for (size_t i = 0; i < side.size(); i++) {
+		if (side[i] != other[i])
+			return std::strchr(letters, side[i]) < std::strchr(letters, other[i]);
+	}
+	return false;
+}
+// Pieces of a table in index order: the white king, the other white pieces strongest first, then black the same way
+struct Material {
+	uint8_t   count{0};
+	PieceType types[max_tablebase_pieces];
+	Color     colors[max_tablebase_pieces];
+	bool      pawns{false};
+	char      name[16]{};
+	// Squares of the white king, the board is mirrored so it stands on files a to d, and without pawns also on
+	// ranks 1 to 4
+	inline uint8_t slots() const {
+		return pawns ? 32 : 16;
+	}
+	inline uint64_t positions() const {
+		return 2ULL * slots() << (6 * (count - 1));
+	}
+};
+// Builds the material from the letters of both sides without kings, swapping them when black is stronger
+bool make_material(std::string white, std::string black, Material& material, bool& flipped) {
+	for (std::string* side: {&white, &black}) {
+		for (char letter: *side) {
+			if (letter == '\0' || std::strchr(letters, letter) == nullptr)
+				return false;
+		}
+		std::sort(side->begin(), side->end(), [](char a, char b) { return std::strchr(letters, a) < std::strchr(letters, b); });
+	}
+	flipped = stronger(black, white);
+	if (flipped)
+		std::swap(white, black);
+	if (white.size() + black.size() + 2 > max_tablebase_pieces
+	    || (white.find('P') != std::string::npos && black.find('P') != std::string::npos))
+		return false;
+	material.count = 0;
+	for (uint8_t side = 0; side < 2; side++) {
+		material.types[material.count]    = PieceType::king;
+		material.colors[material.count++] = (side == 0 ? Color::white : Color::black);
+		for (char letter: side == 0 ? white : black) {
+			material.types[material.count]    = types[std::strchr(letters, letter) - letters];
+			material.colors[material.count++] = (side == 0 ? Color::white : Color::black);
+		}
+	}
+	material.pawns = (white + black).find('P') != std::string::npos;
+	std::snprintf(material.name, sizeof(material.name), "K%svK%s", white.c_str(), black.c_str());
+	return true;
+}
+bool parse_material(const char* name, Material& material) {
+	const char* separator = std::strchr(name, 'v');
+	if (name[0] != 'K' || separator == nullptr || separator[1] != 'K')
+		return false;
+	bool flipped;
+	return make_material(std::string(name + 1, separator), std::string(separator + 2), material, flipped);
+}
+// Material on the board, flipped is set when the colors have to be swapped to match the table
+bool board_material(const Board& board, Material& material, bool& flipped) {
+	std::string sides[2];
+	for (uint8_t side = 0; side < 2; side++) {
+		const Color color = (side == 0 ? Color::white : Color::black);
+		if (bit_count(board.pieces(color, PieceType::king)) != 1)
+			return false;
+		for (uint8_t i = 0; i < 5; i++)
+			sides[side].append(bit_count(board.pieces(color, types[i])), letters[i]);
+	}
+	if (sides[0].size() + sides[1].size() + 2 > max_tablebase_pieces)
+		return false;
+	return make_material(sides[0], sides[1], material, flipped);
+}
+struct Position {
+	uint8_t squares[max_tablebase_pieces];
+	Color   turn;
+};
+// Index of the position after mirroring the white king into its slot, equal pieces are ordered by square so
+// every position has one index
+uint64_t index_of(const Material& material, Position position) {
+	if (position.squares[0] % 8 < 4) {
+		for (uint8_t i = 0; i < material.count; i++)
+			position.squares[i] ^= 7;
+	}
+	if (!material.pawns && position.squares[0] / 8 < 4) {
+		for (uint8_t i = 0; i < material.count; i++)
+			position.squares[i] ^= 56;
+	}
+	for (uint8_t i = 1; i < material.count; i++) {
+		for (uint8_t j = i; j > 1 && material.types[j] == material.types[j - 1]
+		                    && material.colors[j] == material.colors[j - 1]
+		                    && position.squares[j] < position.squares[j - 1];
+		     j--)
+			std::swap(position.squares[j], position.squares[j - 1]);
+	}
+	const uint8_t king = position.squares[0];
+	uint64_t      index =
+	    static_cast<uint8_t>(position.turn) * material.slots() + (king / 8 - (material.pawns ? 0 : 4)) * 4 + king % 8 - 4;
+	for (uint8_t i = 1; i < material.count; i++)
+		index = index * 64 + position.squares[i];
+	return index;
+}
+Position position_of(const Material& material, uint64_t index) {
+	Position position;
+	for (uint8_t i = material.count - 1; i > 0; i--, index /= 64)
+		position.squares[i] = index % 64;
+	const uint8_t slot  = index % material.slots();
+	position.squares[0] = (slot / 4 + (material.pawns ? 0 : 4)) * 8 + slot % 4 + 4;
+	position.turn       = (index / material.slots() == 0 ? Color::white : Color::black);
+	return position;
+}
+// Squares of the pieces of the board in table order, colors swapped and the board turned when flipped
+Position board_position(const Board& board, Color turn, const Material& material, bool flipped) {
+	Position position;
+	position.turn = (flipped ? opponent(turn) : turn);
+	uint64_t used = 0;
+	for (uint8_t i = 0; i < material.count; i++) {
+		const Color    color  = (flipped ? opponent(material.colors[i]) : material.colors[i]);
+		const uint64_t pieces = board.pieces(color, material.types[i]) & ~used;
+		position.squares[i]   = lowest_bit(pieces);
+		used |= bit(position.squares[i]);
+		if (flipped)
+			position.squares[i] ^= 56;
+	}
+	return position;
+}
+// Board of a position, rooks count as moved so no castling is possible
+bool make_board(const Material& material, const Position& position, Board& board) {
+	uint32_t data[8]{};
+	uint64_t used = 0;
+	for (uint8_t i = 0; i < material.count; i++) {
+		const uint8_t square = position.squares[i];
+		if ((used & bit(square)) != 0)
+			return false;
+		if (material.types[i] == PieceType::pawn && (square / 8 == 0 || square / 8 == 7))
+			return false;
+		// Equal pieces out of order are another index of a position that already has one
+		if (i > 1 && material.types[i] == material.types[i - 1] && material.colors[i] == material.colors[i - 1]
+		    && square < position.squares[i - 1])
+			return false;
+		used |= bit(square);
+		constexpr uint8_t nibbles[8] = {1, 3, 4, 6, 5, 7, 0, 0};
+		const uint8_t     nibble     = nibbles[static_cast<uint8_t>(material.types[i])]
+		                       | (material.colors[i] == Color::black ? 0x08 : 0);
+		data[square / 8] |= static_cast<uint32_t>(nibble) << ((square % 8) * 4);
+	}
+	board.set_data(data, position.turn);
+	return true;
+}
+bool attacked(const Board& board, uint8_t square, Color by) {
+	const uint64_t occupied = board.occupied();
+	const uint64_t queens   = board.pieces(by, PieceType::queen);
+	return ((pawn_attacks(square, opponent(by)) & board.pieces(by, PieceType::pawn))
+	        | (knight_attacks(square) & board.pieces(by, PieceType::knight))
+	        | (king_attacks(square) & board.pieces(by, PieceType::king))
+	        | (bishop_attacks(square, occupied) & (board.pieces(by, PieceType::bishop) | queens))
+	        | (rook_attacks(square, occupied) & (board.pieces(by, PieceType::rook) | queens)))
+	       != 0;
+}
+// Squares a piece standing on square could have come from without capturing
+uint64_t origins(PieceType type, Color color, uint8_t square, uint64_t occupied) {
+	const uint64_t empty = ~occupied;
+	switch (type) {
+	case PieceType::knight: return knight_attacks(square) & empty;
+	case PieceType::bishop: return bishop_attacks(square, occupied) & empty;
+	case PieceType::rook: return rook_attacks(square, occupied) & empty;
+	case PieceType::queen: return queen_attacks(square, occupied) & empty;
+	case PieceType::king: return king_attacks(square) & empty;
+	case PieceType::pawn: {
+		// White pawns come from higher indices, single steps from rank 2 up and double steps onto rank 4
+		const int8_t  step   = (color == Color::white ? 8 : -8);
+		const uint8_t single = square + step;
+		if (single / 8 == 0 || single / 8 == 7 || (occupied & bit(single)) != 0)
+			return 0;
+		const bool double_step = (color == Color::white ? square / 8 == 4 : square / 8 == 3);
+		return bit(single) | (double_step ? bit(single + step) & empty : 0);
+	}
+	default: return 0;
+	}
+}
+// Value of a move for the side making it, from the value of the position it leads to
+uint8_t backed_up(uint8_t child) {
+	return child == draw ? draw : decided(child - 2 + 1);
+}
+// Whether value a is better than value b for the side to move, wins shortest first, then draws, then the
+// longest losses
+bool better(uint8_t a, uint8_t b) {
+	const auto rank = [](uint8_t value) -> int32_t {
+		if (value == draw)
+			return 0;
+		const int32_t plies = value - 2;
+		return plies % 2 == 1 ? 1024 - plies : -1024 + plies;
+	};
+	return rank(a) > rank(b);
+}
+// Runs work(begin, end) over [0, size) in blocks taken by threads threads
+template <typename Work> void parallel(uint64_t size, uint8_t threads, const Work& work) {
+	constexpr uint64_t       block = 1 << 14;
+	std::atomic<uint64_t>    next{0};
+	std::vector<std::thread> workers;
+	for (uint8_t i = 0; i < threads; i++) {
+		workers.emplace_back([&]() {
+			for (uint64_t begin = next.fetch_add(block); begin < size; begin = next.fetch_add(block))
+				work(begin, begin + block < size ? begin + block : size);
+		});
+	}
+	for (std::thread& worker: workers)
+		worker.join();
+}
+// Retrograde solver of one material. Every position first counts its moves that stay in the table and takes
+// the best result of the captures and promotions that leave it, looked up in the smaller tables. Then ply by ply,
+// the predecessors of every loss become wins and those of every win lose one move, a position left without
+// moves that do not lose is lost itself. Positions never decided are draws.
+class Solver {
+	const Material&                     m_material;
+	const Tablebases&                   m_children;
+	const uint8_t                       m_threads;
+	const uint64_t                      m_size;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_values;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_counters; // moves staying in the table not known to lose
+	std::unique_ptr<uint8_t[]>          m_exits;        // best value of the moves leaving the table
+	std::atomic<uint16_t>               m_last{0};      // longest distance decided so far
+	std::atomic<bool>                   m_missing{false};
+
+public:
+	Solver(const Material& material, const Tablebases& children, uint8_t threads) :
+	    m_material(material), m_children(children), m_threads(threads), m_size(material.positions()),
+	    m_values(new std::atomic<uint8_t>[m_size]()), m_counters(new std::atomic<uint8_t>[m_size]()),
+	    m_exits(new uint8_t[m_size]) {
+		std::fill(m_exits.get(), m_exits.get() + m_size, no_exit);
+	}
+
+private:
+	void decide(uint64_t index, uint16_t plies) {
+		m_values[index].store(decided(plies), std::memory_order_relaxed);
+		for (uint16_t last = m_last.load(); plies > last && !m_last.compare_exchange_weak(last, plies);)
+			;
+	}
+	void initialize(uint64_t index) {
+		Board          board;
+		const Position position = position_of(m_material, index);
+		if (!make_board(m_material, position, board)
+		    || attacked(board, lowest_bit(board.pieces(opponent(position.turn), PieceType::king)), position.turn)) {
+			m_values[index].store(illegal, std::memory_order_relaxed);
+			return;
+		}
+		const AvailableMoves available{board, position.turn};
+		if (available.count() == 0) {
+			if (available.in_check())
+				decide(index, 0);
+			return;
+		}
+		uint8_t internal = 0;
+		uint8_t exit     = no_exit;
+		for (Move move: available) {
+			if (!move.is_capture(board) && !move.is_promotion()) {
+				internal++;
+				continue;
+			}
+			Board child{board};
+			child.make_move(move);
+			TablebaseEntry entry{0, 0};
+			if (bit_count(child.occupied()) > 2 && !m_children.probe(child, opponent(position.turn), entry)) {
+				m_missing.store(true);
+				continue;
+			}
+			const uint8_t value = backed_up(entry.wdl == 0 ? draw : decided(entry.plies));
+			if (exit == no_exit || better(value, exit))
+				exit = value;
+		}
+		m_counters[index].store(internal, std::memory_order_relaxed);
+		m_exits[index] = exit;
+		if (internal == 0 && exit != draw)
+			decide(index, exit - 2);
+	}
+	// Wins by leaving the table take effect at their distance, unless a shorter win was found meanwhile
+	void exit_wins(uint64_t index, uint16_t plies) {
+		if (m_values[index].load(std::memory_order_relaxed) == 0 && m_exits[index] == decided(plies))
+			m_values[index].store(decided(plies), std::memory_order_relaxed);
+	}
+	void retract(uint64_t index, uint16_t plies) {
+		Position       position = position_of(m_material, index);
+		const Color    mover    = opponent(position.turn);
+		uint64_t       occupied = 0;
+		for (uint8_t i = 0; i < m_material.count; i++)
+			occupied |= bit(position.squares[i]);
+		for (uint8_t i = 0; i < m_material.count; i++) {
+			if (m_material.colors[i] != mover)
+				continue;
+			const uint8_t square = position.squares[i];
+			for (uint64_t from = origins(m_material.types[i], mover, square, occupied); from != 0; from &= from - 1) {
+				Position previous   = position;
+				previous.squares[i] = lowest_bit(from);
+				previous.turn       = mover;
+				const uint64_t parent = index_of(m_material, previous);
+				uint8_t        value  = 0;
+				if (plies % 2 == 0) {
+					// Moving into a lost position wins
+					if (m_values[parent].compare_exchange_strong(value, decided(plies + 1), std::memory_order_relaxed))
+						decide(parent, plies + 1);
+					continue;
+				}
+				if (m_values[parent].load(std::memory_order_relaxed) != 0
+				    || m_counters[parent].fetch_sub(1, std::memory_order_relaxed) != 1)
+					continue;
+				// Every move staying in the table loses, the position is lost unless an exit holds
+				const uint8_t exit = m_exits[parent];
+				if (exit == no_exit)
+					decide(parent, plies + 1);
+				else if (exit != draw && (exit - 2) % 2 == 0)
+					decide(parent, exit - 2 > plies + 1 ? exit - 2 : plies + 1);
+			}
+		}
+	}
+
+public:
+	// False when a table the captures or promotions lead to is missing or a distance does not fit
+	bool solve() {
+		parallel(m_size, m_threads, [this](uint64_t begin, uint64_t end) {
+			for (uint64_t i = begin; i < end; i++)
+				initialize(i);
+		});
+		if (m_missing.load())
+			return false;
+		uint16_t longest_exit = 0;
+		for (uint64_t i = 0; i < m_size; i++) {
+			if (m_exits[i] != no_exit && m_exits[i] != draw && m_exits[i] - 2 > longest_exit)
+				longest_exit = m_exits[i] - 2;
+		}
+		for (uint16_t plies = 0; plies <= m_last.load() || plies <= longest_exit; plies++) {
+			if (plies > max_plies)
+				return false;
+			if (plies % 2 == 1) {
+				parallel(m_size, m_threads, [this, plies](uint64_t begin, uint64_t end) {
+					for (uint64_t i = begin; i < end; i++)
+						exit_wins(i, plies);
+				});
+			}
+			parallel(m_size, m_threads, [this, plies](uint64_t begin, uint64_t end) {
+				for (uint64_t i = begin; i < end; i++) {
+					if (m_values[i].load(std::memory_order_relaxed) == decided(plies))
+						retract(i, plies);
+				}
+			});
+		}
+		return true;
+	}
+	uint8_t value(uint64_t index) const {
+		return m_values[index].load(std::memory_order_relaxed);
+	}
+};
+} // namespace
+struct Tablebases::Table {
+	Material        material;
+	const void*     mapping;
+	size_t          length;
+	const uint64_t* words;
+	uint8_t         bits;
+	uint8_t value(uint64_t index) const {
+		const uint64_t first = index * bits;
+		const uint8_t  shift = first % 64;
+		uint64_t       value = words[first / 64] >> shift;
+		if (shift + bits > 64)
+			value |= words[first / 64 + 1] << (64 - shift);
+		return value & ((1U << bits) - 1);
+	}
+};
+Tablebases::~Tablebases() {
+	close();
+}
+void Tablebases::close() {
+	for (Table* table: m_tables) {
+		munmap(const_cast<void*>(table->mapping), table->length);
+		delete table;
+	}
+	m_tables.clear();
+	m_pieces = 0;
+}
+bool Tablebases::add(const char* path) {
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+		::close(file);
+		return false;
+	}
+	void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+	::close(file);
+	if (mapping == MAP_FAILED)
+		return false;
+	const Header* header = static_cast<const Header*>(mapping);
+	Material      material;
+	if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || std::memchr(header->material, '\0', 16) == nullptr
+	    || !parse_material(header->material, material) || std::strcmp(material.name, header->material) != 0
+	    || header->positions != material.positions() || header->bits == 0 || header->bits > 8
+	    || static_cast<size_t>(status.st_size) < sizeof(Header) + (header->positions * header->bits + 63) / 64 * 8) {
+		munmap(mapping, status.st_size);
+		return false;
+	}
+	// Values are found by index, any page of the table may be needed next
+	madvise(mapping, status.st_size, MADV_RANDOM);
+	Table* table = new Table{material, mapping, static_cast<size_t>(status.st_size),
+	                         reinterpret_cast<const uint64_t*>(static_cast<const char*>(mapping) + sizeof(Header)),
+	                         header->bits};
+	m_tables.push_back(table);
+	if (material.count > m_pieces)
+		m_pieces = material.count;
+	return true;
+}
+bool Tablebases::open(const char* directory) {
+	DIR* listing = opendir(directory);
+	if (listing == nullptr)
+		return false;
+	for (const dirent* entry = readdir(listing); entry != nullptr; entry = readdir(listing)) {
+		const size_t length = std::strlen(entry->d_name);
+		if (length > 3 && std::strcmp(entry->d_name + length - 3, ".tb") == 0)
+			add((std::string(directory) + "/" + entry->d_name).c_str());
+	}
+	closedir(listing);
+	return true;
+}
+bool Tablebases::probe(const Board& board, Color turn, TablebaseEntry& entry) const {
+	if (bit_count(board.occupied()) > m_pieces)
+		return false;
+	// Castling is still possible while a king on its home square has an unmoved rook
+	if ((board.get_piece(59) == Piece::white_king
+	     && (board.get_piece(56) == Piece::white_rook_unmoved || board.get_piece(63) == Piece::white_rook_unmoved))
+	    || (board.get_piece(3) == Piece::black_king
+	        && (board.get_piece(0) == Piece::black_rook_unmoved || board.get_piece(7) == Piece::black_rook_unmoved)))
+		return false;
+	Material material;
+	bool     flipped;
+	if (!board_material(board, material, flipped))
+		return false;
+	for (const Table* table: m_tables) {
+		if (std::strcmp(table->material.name, material.name) != 0)
+			continue;
+		const uint8_t value = table->value(index_of(material, board_position(board, turn, material, flipped)));
+		if (value == illegal)
+			return false;
+		entry.plies = (value == draw ? 0 : value - 2);
+		entry.wdl   = (value == draw ? 0 : entry.plies % 2 == 1 ? 1 : -1);
+		return true;
+	}
+	return false;
+}
+bool Tablebases::generate(const char* name, const char* directory, uint8_t threads) {
+	Material material;
+	if (!parse_material(name, material))
+		return false;
+	for (const Table* table: m_tables) {
+		if (std::strcmp(table->material.name, material.name) == 0)
+			return true;
+	}
+	const std::string path = std::string(directory) + "/" + material.name + ".tb";
+	if (add(path.c_str()))
+		return true;
+	// Every capture and promotion leads to a smaller or different table, solved first
+	const char* separator = std::strchr(material.name, 'v');
+	std::string sides[2]  = {std::string(material.name + 1, separator - material.name - 1), std::string(separator + 2)};
+	for (uint8_t side = 0; side < 2; side++) {
+		for (size_t i = 0; i < sides[side].size(); i++) {
+			std::string smaller[2] = {sides[0], sides[1]};
+			smaller[side].erase(i, 1);
+			Material child;
+			bool     flipped;
+			if (smaller[0].size() + smaller[1].size() > 0 && make_material(smaller[0], smaller[1], child, flipped)
+			    && !generate(child.name, directory, threads))
+				return false;
+			if (sides[side][i] != 'P')
+				continue;
+			for (char promotion: {'Q', 'R', 'B', 'N'}) {
+				std::string promoted[2] = {sides[0], sides[1]};
+				promoted[side][i]       = promotion;
+				if (make_material(promoted[0], promoted[1], child, flipped) && !generate(child.name, directory, threads))
+					return false;
+			}
+		}
+	}
+	Solver solver{material, *this, threads == 0 ? static_cast<uint8_t>(1) : threads};
+	if (!solver.solve())
+		return false;
+	const uint64_t positions = material.positions();
+	uint8_t        largest   = 0;
+	for (uint64_t i = 0; i < positions; i++) {
+		if (solver.value(i) > largest)
+			largest = solver.value(i);
+	}
+	Header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	std::strcpy(header.material, material.name);
+	header.positions = positions;
+	header.bits      = 1;
+	while ((1U << header.bits) <= largest)
+		header.bits++;
+	// One spare word lets the prober read two words for any value
+	std::vector<uint64_t> words((positions * header.bits + 63) / 64 + 1, 0);
+	for (uint64_t i = 0; i < positions; i++) {
+		const uint64_t first = i * header.bits;
+		const uint64_t value = solver.value(i);
+		words[first / 64] |= value << (first % 64);
+		if (first % 64 + header.bits > 64)
+			words[first / 64 + 1] |= value >> (64 - first % 64);
+	}
+	FILE* output = fopen(path.c_str(), "wb");
+	if (output == nullptr)
+		return false;
+	const bool written = fwrite(&header, sizeof(header), 1, output) == 1
+	                     && fwrite(words.data(), sizeof(uint64_t), words.size(), output) == words.size();
+	if (fclose(output) != 0 || !written)
+		return false;
+	return add(path.c_str());
+}
+} // namespace Engine
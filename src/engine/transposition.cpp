@@ -0,0 +1,112 @@
+#include "engine.hpp"
+#include <atomic>
+#include <new>
+namespace Engine {
+struct TranspositionTable::Slot {
+	std::atomic<uint64_t> check; // hash ^ data
+	std::atomic<uint64_t> data;
+};
+namespace {
+constexpr uint8_t bucket_slots = 4;
+// One cache line per bucket, a probe touches a single line
+struct alignas(64) Bucket {
+	TranspositionTable::Slot slots[bucket_slots];
+};
+uint64_t pack(const TranspositionTable::Entry& entry, uint8_t generation) {
+	return static_cast<uint64_t>(entry.move) | static_cast<uint64_t>(static_cast<uint16_t>(entry.score)) << 16
+	       | static_cast<uint64_t>(entry.depth) << 32 | static_cast<uint64_t>(entry.bound) << 40
+	       | static_cast<uint64_t>(generation) << 48;
+}
+TranspositionTable::Entry unpack(uint64_t data) {
+	TranspositionTable::Entry entry;
+	entry.move  = static_cast<uint16_t>(data);
+	entry.score = static_cast<int16_t>(static_cast<uint16_t>(data >> 16));
+	entry.depth = static_cast<uint8_t>(data >> 32);
+	entry.bound = static_cast<TranspositionTable::Bound>((data >> 40) & 0x03);
+	return entry;
+}
+uint8_t generation_of(uint64_t data) {
+	return static_cast<uint8_t>(data >> 48);
+}
+} // namespace
+TranspositionTable::TranspositionTable(size_t megabytes) {
+	// A table too large for the memory falls back to the smallest one
+	if (!resize(megabytes))
+		resize(0);
+}
+TranspositionTable::~TranspositionTable() {
+	delete[] reinterpret_cast<Bucket*>(m_slots);
+}
+bool TranspositionTable::resize(size_t megabytes) {
+	size_t buckets = megabytes * 1024 * 1024 / sizeof(Bucket);
+	if (buckets == 0)
+		buckets = 1;
+	Bucket* const slots = new (std::nothrow) Bucket[buckets];
+	if (slots == nullptr)
+		return false;
+	delete[] reinterpret_cast<Bucket*>(m_slots);
+	m_slots   = reinterpret_cast<Slot*>(slots);
+	m_buckets = buckets;
+	clear();
+	return true;
+}
+void TranspositionTable::clear() {
+	for (size_t i = 0; i < m_buckets * bucket_slots; i++) {
+		m_slots[i].check.store(0, std::memory_order_relaxed);
+		m_slots[i].data.store(0, std::memory_order_relaxed);
+	}
+	m_generation = 0;
+}
+void TranspositionTable::new_search() {
+	m_generation++;
+}
+bool TranspositionTable::probe(uint64_t hash, Entry& entry) const {
+	const Slot* bucket = m_slots + static_cast<size_t>((static_cast<unsigned __int128>(hash) * m_buckets) >> 64) * bucket_slots;
+	for (uint8_t i = 0; i < bucket_slots; i++) {
+		const uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+		if ((bucket[i].check.load(std::memory_order_relaxed) ^ data) == hash && data != 0) {
+			entry = unpack(data);
+			return true;
+		}
+	}
+	return false;
+}
+void TranspositionTable::store(uint64_t hash, const Entry& entry) {
+	Slot* bucket = m_slots + static_cast<size_t>((static_cast<unsigned __int128>(hash) * m_buckets) >> 64) * bucket_slots;
+	Slot* victim = bucket;
+	int   worst  = 0x7FFFFFFF;
+	for (uint8_t i = 0; i < bucket_slots; i++) {
+		const uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+		if ((bucket[i].check.load(std::memory_order_relaxed) ^ data) == hash) {
+			// Same position, keep the known move if the new result has none
+			Entry merged = entry;
+			if (merged.move == 0)
+				merged.move = unpack(data).move;
+			const uint64_t packed = pack(merged, m_generation);
+			bucket[i].data.store(packed, std::memory_order_relaxed);
+			bucket[i].check.store(hash ^ packed, std::memory_order_relaxed);
+			return;
+		}
+		// Shallow entries from older searches are replaced first
+		const uint8_t age   = m_generation - generation_of(data);
+		const int     value = (data == 0 ? -0x10000 : unpack(data).depth - 8 * age);
+		if (value < worst) {
+			worst  = value;
+			victim = bucket + i;
+		}
+	}
+	const uint64_t packed = pack(entry, m_generation);
+	victim->data.store(packed, std::memory_order_relaxed);
+	victim->check.store(hash ^ packed, std::memory_order_relaxed);
+}
+uint16_t TranspositionTable::permille_full() const {
+	const size_t sampled = (m_buckets * bucket_slots < 1000 ? m_buckets * bucket_slots : 1000);
+	size_t       used    = 0;
+	for (size_t i = 0; i < sampled; i++) {
+		const uint64_t data = m_slots[i].data.load(std::memory_order_relaxed);
+		if (data != 0 && generation_of(data) == m_generation)
+			used++;
+	}
+	return static_cast<uint16_t>(used * 1000 / sampled);
+}
+} // namespace Engine
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+namespace Engine {
+// Next value of a splitmix64 sequence, also usable at compile time for key tables
+constexpr uint64_t splitmix64(uint64_t& state) {
+	uint64_t result = (state += 0x9E3779B97F4A7C15ULL);
+	result          = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	result          = (result ^ (result >> 27)) * 0x94D049BB133111EBULL;
+	return result ^ (result >> 31);
+}
+// Writes the whole buffer, retrying partial writes
+inline bool write_all(int file, const char* data, size_t size) {
+	while (size > 0) {
+		const ssize_t written = ::write(file, data, size);
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+} // namespace Engine
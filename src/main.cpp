@@ -1,10 +1,143 @@
 #include "engine/engine.hpp"
 #include "renderer/renderer.hpp"
-int main() {
-	Engine::Game game{new Engine::RandomPlayer(), new Engine::RandomPlayer()};
-	Renderer::TUI tui{1, game};
-	while (true) {
+#include "server/server.hpp"
+#include "uci/uci.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+namespace {
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s [--uci | --selfplay <games> [options] | --server <socket> [options]]\n"
+	        "--uci speaks the Universal Chess Interface on the standard streams\n"
+	        "--server hosts games for clients of a Unix-domain socket, see src/server/server.hpp for the protocol,\n"
+	        "its search opponents use the search limits, 100000 nodes per move by default, on --threads workers\n"
+	        "without either a random player plays the search, press enter for every ply\n"
+	        "  --watch             play on without waiting for enter, drawing at most 30 frames a second\n"
+	        "  --threads <n>       games played at once, all cores by default\n"
+	        "  --white <player>    random or search, random by default\n"
+	        "  --black <player>    random or search, random by default\n"
+	        "  --seed <n>          game i seeds its random moves with n + i\n"
+	        "  --random-plies <n>  opening plies played at random\n"
+	        "  --max-plies <n>     longer games are adjudicated as draws, 500 by default\n"
+	        "  --depth <n>         depth limit of search players\n"
+	        "  --nodes <n>         node limit per move of search players\n"
+	        "  --movetime <ms>     time limit per move of search players\n"
+	        "  --hash <mb>         table size of every search player, 16 by default\n"
+	        "  --pgn <file>        write the games to a PGN file\n"
+	        "  --records <file>    write every position played to a binary record file, see tools/records.cpp\n"
+	        "  --book <file>       Polyglot book both sides play from after the random plies\n"
+	        "  --tablebases <dir>  tables that adjudicate games and that search players probe\n",
+	        program);
+}
+bool parse_player(const char* name, Engine::PlayerType& type) {
+	if (std::strcmp(name, "random") == 0)
+		type = Engine::PlayerType::random;
+	else if (std::strcmp(name, "search") == 0)
+		type = Engine::PlayerType::search;
+	else
+		return false;
+	return true;
+}
+int run_self_play(const Engine::SelfPlaySettings& settings) {
+	const Engine::SelfPlayReport report  = Engine::self_play(settings);
+	const double                 seconds = (report.milliseconds > 0 ? report.milliseconds : 1) / 1000.0;
+	printf("games %u plies %lu time %.3f s\n", report.games, static_cast<unsigned long>(report.plies), seconds);
+	printf("%.1f games/s %.0f plies/s\n", report.games / seconds, report.plies / seconds);
+	printf("white wins %u black wins %u draws %u\n", report.white_wins, report.black_wins, report.draws);
+	printf("checkmate %u stalemate %u fifty moves %u repetition %u insufficient material %u ply limit %u tablebase %u\n",
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::checkmate)],
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::stalemate)],
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::fifty_moves)],
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::repetition)],
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::insufficient_material)],
+	       report.terminations[static_cast<uint8_t>(Engine::Termination::none)], report.tablebase);
+	return 0;
+}
+} // namespace
+int main(int argc, char** argv) {
+	Engine::SelfPlaySettings settings;
+	settings.threads = std::thread::hardware_concurrency();
+	bool        headless = false;
+	bool        watch    = false;
+	const char* server   = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--uci") == 0 && argc == 2) {
+			Uci::Protocol protocol{stdout};
+			return protocol.run(stdin);
+		} else if (std::strcmp(argv[i], "--selfplay") == 0 && i + 1 < argc) {
+			settings.games = std::atoi(argv[++i]);
+			headless       = true;
+		} else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			settings.threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--white") == 0 && i + 1 < argc && parse_player(argv[i + 1], settings.white))
+			i++;
+		else if (std::strcmp(argv[i], "--black") == 0 && i + 1 < argc && parse_player(argv[i + 1], settings.black))
+			i++;
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			settings.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--random-plies") == 0 && i + 1 < argc)
+			settings.random_plies = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc)
+			settings.max_plies = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			settings.limits.depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+			settings.limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--movetime") == 0 && i + 1 < argc)
+			settings.limits.milliseconds = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+			settings.hash_megabytes = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--pgn") == 0 && i + 1 < argc)
+			settings.pgn = argv[++i];
+		else if (std::strcmp(argv[i], "--records") == 0 && i + 1 < argc)
+			settings.records = argv[++i];
+		else if (std::strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+			settings.book = argv[++i];
+		else if (std::strcmp(argv[i], "--tablebases") == 0 && i + 1 < argc)
+			settings.tablebases = argv[++i];
+		else if (std::strcmp(argv[i], "--watch") == 0)
+			watch = true;
+		else if (std::strcmp(argv[i], "--server") == 0 && i + 1 < argc)
+			server = argv[++i];
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (headless)
+		return run_self_play(settings);
+	if (server != nullptr) {
+		Server::Settings hosting;
+		hosting.path           = server;
+		hosting.workers        = settings.threads;
+		hosting.limits         = settings.limits;
+		hosting.hash_megabytes = settings.hash_megabytes;
+		// Every move of every game waits for a worker, so the search is kept short unless told otherwise
+		if (hosting.limits.depth == Engine::SearchLimits{}.depth && hosting.limits.nodes == 0
+		    && hosting.limits.milliseconds == 0)
+			hosting.limits.nodes = 100000;
+		return Server::run(hosting);
+	}
+	// The limits given for self-play also apply here, a second per move otherwise
+	Engine::SearchLimits limits = settings.limits;
+	if (limits.depth == Engine::SearchLimits{}.depth && limits.nodes == 0 && limits.milliseconds == 0)
+		limits.milliseconds = 1000;
+	limits.threads = std::thread::hardware_concurrency();
+	Engine::RandomPlayer white;
+	Engine::SearchPlayer black{limits, 64};
+	Engine::Game         game{&white, &black};
+	Renderer::TUI        tui{1, game, static_cast<uint16_t>(watch ? 30 : 0)};
+	while (game.get_termination() == Engine::Termination::none) {
 		tui.render();
+		// Once the input is closed the game plays on by itself
+		int key = 0;
+		while (!watch && (key = getchar()) != '\n' && key != EOF)
+			;
+		watch |= key == EOF;
 		game.advance_turn();
 	}
+	tui.render(true);
+	return 0;
 }
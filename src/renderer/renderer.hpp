@@ -1,19 +1,29 @@
 #pragma once
 #include "../engine/engine.hpp"
+#include <chrono>
+#include <vector>
 namespace Renderer {
+// Draws the board in place, after the first frame only the squares that changed are written
 class TUI {
-	Engine::Game&       m_game;
-	int                m_fd{1};
-	char*              m_cursor{m_buffer};
-	char               m_buffer[1024];
+	Engine::Game&                         m_game;
+	int                                   m_fd{1};
+	std::chrono::steady_clock::duration   m_frame_time;
+	std::chrono::steady_clock::time_point m_last_frame{};
+	bool                                  m_drawn{false}; // the frame around the squares is on screen
+	uint8_t                               m_squares[64]{}; // pieces on screen, as Board::get_piece
+	std::vector<char>                     m_buffer{};
 
 private:
 	void write(const char* str);
+	void write(const char* str, size_t length);
 	void commit();
 
 public:
-	TUI(int fd, Engine::Game& game);
+	// At most frames_per_second frames are drawn, 0 draws every frame
+	TUI(int fd, Engine::Game& game, uint16_t frames_per_second = 30);
+	TUI(const TUI&) = delete;
 	~TUI();
-	void render();
+	// Skips the frame when the previous one was drawn too recently, unless force is set
+	void render(bool force = false);
 };
 } // namespace Renderer
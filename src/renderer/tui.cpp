@@ -1,5 +1,7 @@
 #include "renderer.hpp"
+#include "../engine/profile.hpp"
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <unistd.h>
 constexpr const char* chess_pieces[32] = {
@@ -7,42 +9,76 @@ constexpr const char* chess_pieces[32] = {
     "  ", "♟ ", "♜ ", "♞ ", "♝ ", "♛ ", "♜ ", "♚ ", "  ", "♙ ", "♖ ", "♘ ", "♗ ", "♕ ", "♖ ", "♔ ",
 };
 namespace Renderer {
-TUI::TUI(int fd, Engine::Game& game) : m_game(game), m_fd(fd) {
+TUI::TUI(int fd, Engine::Game& game, uint16_t frames_per_second)
+    : m_game(game), m_fd(fd),
+      m_frame_time(frames_per_second == 0 ? std::chrono::steady_clock::duration::zero()
+                                          : std::chrono::steady_clock::duration(std::chrono::seconds(1))
+                                                / frames_per_second) {
+	m_buffer.reserve(1024);
 	::write(m_fd, "\33[?47l", strlen("\33[?47l"));
 }
 TUI::~TUI() {
 	::write(m_fd, "\33[?47h", strlen("\33[?47h"));
 }
 void TUI::write(const char* str) {
-	size_t length = strlen(str);
-	std::memcpy(m_cursor, str, length);
-	m_cursor += length;
+	write(str, strlen(str));
+}
+void TUI::write(const char* str, size_t length) {
+	m_buffer.insert(m_buffer.end(), str, str + length);
 }
 void TUI::commit() {
-	::write(m_fd, m_buffer, m_cursor - m_buffer);
-	m_cursor = m_buffer;
+	// A slow terminal may take the frame in several pieces
+	for (size_t written = 0; written < m_buffer.size();) {
+		const ssize_t result = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+		if (result <= 0)
+			break;
+		written += result;
+	}
+	m_buffer.clear();
 }
-void TUI::render() {
-	bool is_black{false};
-	write("\33[H\33[J  A B C D E F G H\n");
+void TUI::render(bool force) {
+	const auto now = std::chrono::steady_clock::now();
+	if (!force && m_drawn && now - m_last_frame < m_frame_time)
+		return;
+	m_last_frame = now;
+	PROFILE_SCOPE(render);
+	if (!m_drawn) {
+		// Labels around the board, every square is then drawn as changed
+		write("\33[H\33[J  A B C D E F G H\n");
+		for (int8_t rank = 7; rank >= 0; rank--) {
+			char rank_text[16];
+			write(rank_text, snprintf(rank_text, sizeof(rank_text), "%c \33[19G %c\n", '1' + rank, '1' + rank));
+		}
+		write("  A B C D E F G H\n");
+	}
+	// The cursor moves on by itself along a rank, colours are only written when they change
+	int8_t last_index = -1;
+	int8_t last_color = -1;
 	for (int8_t rank = 7; rank >= 0; rank--) {
-		char rank_text[3] = {static_cast<char>('1' + rank), ' ', '\0'};
-		write(rank_text);
 		for (int8_t file = 0; file < 8; file++) {
-			write(is_black ? "\33[40m\33[37m" : "\33[47m\33[30m");
-			write(chess_pieces[(is_black ? 16 : 0) + static_cast<uint8_t>(m_game.get_board().get_piece(file, rank))]);
-			is_black = !is_black;
+			const uint8_t index = 8 * (7 - rank) + (7 - file);
+			const uint8_t piece = static_cast<uint8_t>(m_game.get_board().get_piece(index));
+			if (m_drawn && m_squares[index] == piece)
+				continue;
+			m_squares[index]   = piece;
+			const int8_t color = (file + rank) % 2 == 0;
+			if (file == 0 || last_index != index + 1) {
+				char position[16];
+				write(position, snprintf(position, sizeof(position), "\33[%d;%dH", 9 - rank, 3 + 2 * file));
+			}
+			if (color != last_color)
+				write(color ? "\33[40m\33[37m" : "\33[47m\33[30m");
+			write(chess_pieces[(color ? 16 : 0) + piece]);
+			last_index = index;
+			last_color = color;
 		}
-		is_black = !is_black;
-		write("\33[0m ");
-		write(rank_text);
-		write("\n");
 	}
-	write("  A B C D E F G H\n");
+	write("\33[0m\33[11;1H\33[K");
 	if (m_game.get_player() == Engine::Color::white)
 		write("white: ");
 	else
 		write("black: ");
+	m_drawn = true;
 	commit();
 }
 } // namespace Renderer
@@ -0,0 +1,530 @@
+#include "server.hpp"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+namespace Server {
+namespace {
+constexpr size_t max_line = 4096; // longer input closes the connection
+enum class Opponent : uint8_t { random, search, human };
+constexpr const char* opponent_names[3] = {"random", "search", "human"};
+// One client socket, written and read without blocking, at most one coroutine waits for its next line
+struct Connection {
+	const int               fd;
+	std::string             input{};
+	std::string             output{};
+	std::coroutine_handle<> reader{};
+	bool                    closed{false};  // the peer hung up or the socket failed, it is no longer polled
+	bool                    writing{false}; // the loop waits for the socket to take the rest of the output
+	explicit Connection(int fd) : fd(fd) {}
+};
+// Search handed to a worker thread, the game awaiting it is resumed on the loop with the move
+struct SearchJob {
+	Engine::Board           board;
+	Engine::Color           turn;
+	Engine::Move            move{};
+	std::coroutine_handle<> game{};
+	SearchJob(const Engine::Board& board, Engine::Color turn) : board(board), turn(turn) {}
+};
+class Loop {
+	const Settings&                      m_settings;
+	Engine::SearchLimits                 m_limits;
+	int                                  m_epoll{-1};
+	int                                  m_listener{-1};
+	int                                  m_wake{-1};    // eventfd the workers signal finished searches on
+	int                                  m_signals{-1}; // signalfd of SIGINT and SIGTERM
+	std::unordered_map<int, Connection*> m_connections{};
+	std::vector<Connection*>             m_closing{}; // freed once the events of the current wait are handled
+	std::deque<Connection*>              m_waiting[2]{}; // clients waiting for a human opponent, by their colour
+	uint32_t                             m_games{0};
+	uint64_t                             m_seed;
+	std::vector<std::thread>             m_workers{};
+	std::mutex                           m_mutex; // guards the job queues and m_stopping
+	std::condition_variable              m_work;
+	std::deque<SearchJob*>               m_jobs{};
+	std::deque<SearchJob*>               m_done{};
+	bool                                 m_stopping{false};
+	std::atomic<bool>                    m_abort{false}; // ends the running searches on shutdown
+
+public:
+	explicit Loop(const Settings& settings);
+	Loop(const Loop&) = delete;
+	~Loop();
+
+private:
+	void watch(int fd, uint32_t events, int operation);
+	void accept_all();
+	void receive(Connection& connection);
+	void flush(Connection& connection);
+	void finish_searches();
+	void work();
+
+public:
+	// Returns false if the socket cannot be set up
+	bool open();
+	int  run();
+	void send(Connection& connection, const std::string& text);
+	void close(Connection& connection);
+	// Hands the connection to a game, or queues it until a client asks for the other colour
+	void start(Connection& connection, Engine::Color color, Opponent opponent);
+	std::string stats() const;
+	inline void game_started() {
+		m_games++;
+	}
+	inline void game_finished() {
+		m_games--;
+	}
+	struct LineAwaiter {
+		Connection&  connection;
+		std::string& line;
+		inline bool  await_ready() const {
+			return connection.closed || connection.input.find('\n') != std::string::npos;
+		}
+		inline void await_suspend(std::coroutine_handle<> reader) {
+			connection.reader = reader;
+		}
+		// False once the connection is closed and no complete line is left
+		bool await_resume();
+	};
+	inline LineAwaiter read_line(Connection& connection, std::string& line) {
+		return {connection, line};
+	}
+	struct SearchAwaiter {
+		Loop&       loop;
+		SearchJob   job;
+		inline bool await_ready() const {
+			return false;
+		}
+		void                await_suspend(std::coroutine_handle<> game);
+		inline Engine::Move await_resume() const {
+			return job.move;
+		}
+	};
+	inline SearchAwaiter search(const Engine::Board& board, Engine::Color turn) {
+		return {*this, SearchJob{board, turn}};
+	}
+};
+bool Loop::LineAwaiter::await_resume() {
+	const size_t end = connection.input.find('\n');
+	if (end == std::string::npos)
+		return false;
+	line.assign(connection.input, 0, end > 0 && connection.input[end - 1] == '\r' ? end - 1 : end);
+	connection.input.erase(0, end + 1);
+	return true;
+}
+void Loop::SearchAwaiter::await_suspend(std::coroutine_handle<> game) {
+	job.game = game;
+	{
+		std::lock_guard<std::mutex> lock{loop.m_mutex};
+		loop.m_jobs.push_back(&job);
+	}
+	loop.m_work.notify_one();
+}
+// The client of a remote player answers every `turn` line with a move
+class RemotePlayer : public AsyncPlayer {
+	Loop&       m_loop;
+	Connection& m_connection;
+
+public:
+	RemotePlayer(Loop& loop, Connection& connection) : m_loop(loop), m_connection(connection) {}
+	Task<Engine::Move> get_move(const Engine::Game& game) override;
+};
+Engine::Move parse_move(const Engine::Game& game, const std::string& text) {
+	const Engine::AvailableMoves available{game.get_board(), game.get_player()};
+	return Engine::parse_san(game.get_board(), available, text.c_str(), text.size());
+}
+std::string turn_line(const Engine::Game& game) {
+	char fen[Engine::fen_size];
+	game.get_fen(fen);
+	return std::string("turn ") + fen + "\n";
+}
+Task<Engine::Move> RemotePlayer::get_move(const Engine::Game& game) {
+	m_loop.send(m_connection, turn_line(game));
+	std::string line;
+	while (co_await m_loop.read_line(m_connection, line)) {
+		if (line == "resign")
+			break;
+		const Engine::Move move = parse_move(game, line);
+		if (move != Engine::Move{})
+			co_return move;
+		m_loop.send(m_connection, "illegal " + line + "\n");
+	}
+	co_return Engine::Move{};
+}
+class RandomOpponent : public AsyncPlayer {
+	Engine::RandomPlayer m_player;
+
+public:
+	explicit RandomOpponent(uint64_t seed) : m_player(seed) {}
+	Task<Engine::Move> get_move(const Engine::Game& game) override {
+		const Engine::AvailableMoves available{game.get_board(), game.get_player()};
+		co_return m_player.get_move(game, available);
+	}
+};
+class SearchOpponent : public AsyncPlayer {
+	Loop& m_loop;
+
+public:
+	explicit SearchOpponent(Loop& loop) : m_loop(loop) {}
+	Task<Engine::Move> get_move(const Engine::Game& game) override {
+		co_return co_await m_loop.search(game.get_board(), game.get_player());
+	}
+};
+struct Side {
+	std::unique_ptr<AsyncPlayer> player;
+	Connection*                  connection; // nullptr for the engine
+	Opponent                     type;
+};
+// True once the side to move has no move or a draw rule applies, kept out of the coroutines so the move list
+// never takes space in a frame
+bool finished(Engine::Game& game) {
+	return game.check_termination(Engine::AvailableMoves{game.get_board(), game.get_player()});
+}
+std::string moved_line(const Engine::Game& game, Engine::Move move) {
+	char san[16];
+	Engine::write_san(game.get_board(), game.get_player(), move, san);
+	return std::string("moved ") + san + "\n";
+}
+std::string result_line(const Engine::Game& game, bool resigned) {
+	constexpr const char* reasons[6] = {"", "checkmate", "stalemate", "fifty-moves", "repetition",
+	                                    "insufficient-material"};
+	if (resigned)
+		return game.get_player() == Engine::Color::white ? "result 0-1 resignation\n" : "result 1-0 resignation\n";
+	const char* result = "1/2-1/2";
+	if (game.get_result() == Engine::GameResult::white_wins)
+		result = "1-0";
+	else if (game.get_result() == Engine::GameResult::black_wins)
+		result = "0-1";
+	return std::string("result ") + result + " " + reasons[static_cast<uint8_t>(game.get_termination())] + "\n";
+}
+// The whole game lives in this frame, it ends by closing the connections of both sides
+Detached play_game(Loop& loop, Side white, Side black) {
+	Side* const  sides[2] = {&white, &black};
+	Engine::Game game{nullptr, nullptr};
+	bool         resigned = false;
+	loop.game_started();
+	for (uint8_t i = 0; i < 2; i++) {
+		if (sides[i]->connection != nullptr)
+			loop.send(*sides[i]->connection, std::string("game ") + (i == 0 ? "white " : "black ")
+			                                     + opponent_names[static_cast<uint8_t>(sides[1 - i]->type)] + "\n");
+	}
+	while (!finished(game)) {
+		const uint8_t      turn = static_cast<uint8_t>(game.get_player());
+		const Engine::Move move = co_await sides[turn]->player->get_move(game);
+		if (move == Engine::Move{}) {
+			resigned = true;
+			break;
+		}
+		if (sides[1 - turn]->connection != nullptr)
+			loop.send(*sides[1 - turn]->connection, moved_line(game, move));
+		game.play(move);
+	}
+	for (Side* side: sides) {
+		if (side->connection == nullptr)
+			continue;
+		loop.send(*side->connection, result_line(game, resigned));
+		loop.close(*side->connection);
+	}
+	loop.game_finished();
+}
+// Reads commands until the client starts a game or leaves
+Detached session(Loop& loop, Connection& connection) {
+	std::string line;
+	while (co_await loop.read_line(connection, line)) {
+		char colour[8], opponent[8];
+		if (line == "quit")
+			break;
+		if (line == "stats") {
+			loop.send(connection, loop.stats());
+			continue;
+		}
+		if (sscanf(line.c_str(), "play %7s %7s", colour, opponent) == 2
+		    && (std::strcmp(colour, "white") == 0 || std::strcmp(colour, "black") == 0)) {
+			const Engine::Color color = (colour[0] == 'w' ? Engine::Color::white : Engine::Color::black);
+			for (uint8_t i = 0; i < 3; i++) {
+				if (std::strcmp(opponent, opponent_names[i]) == 0) {
+					loop.start(connection, color, static_cast<Opponent>(i));
+					co_return;
+				}
+			}
+		}
+		loop.send(connection, "error " + line + "\n");
+	}
+	loop.close(connection);
+}
+Loop::Loop(const Settings& settings) : m_settings(settings), m_limits(settings.limits), m_seed(time(NULL)) {
+	m_limits.stop = &m_abort;
+}
+Loop::~Loop() {
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_stopping = true;
+	}
+	m_abort.store(true);
+	m_work.notify_all();
+	for (std::thread& worker: m_workers)
+		worker.join();
+	// Games still running are abandoned with their frames, only the sockets are released
+	for (auto& entry: m_connections) {
+		::close(entry.first);
+		delete entry.second;
+	}
+	for (Connection* connection: m_closing)
+		delete connection;
+	for (int fd: {m_listener, m_wake, m_signals, m_epoll}) {
+		if (fd >= 0)
+			::close(fd);
+	}
+	if (m_listener >= 0)
+		unlink(m_settings.path);
+}
+void Loop::watch(int fd, uint32_t events, int operation) {
+	epoll_event event{};
+	event.events  = events;
+	event.data.fd = fd;
+	epoll_ctl(m_epoll, operation, fd, &event);
+}
+bool Loop::open() {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (std::strlen(m_settings.path) >= sizeof(address.sun_path))
+		return false;
+	std::strcpy(address.sun_path, m_settings.path);
+	// Every game holds a socket, the soft limit of open files is raised as far as allowed
+	rlimit files;
+	if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+		files.rlim_cur = files.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &files);
+	}
+	// The workers inherit the blocked signals, so only the signalfd sees them
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+	m_epoll   = epoll_create1(EPOLL_CLOEXEC);
+	m_wake    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	m_signals = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_epoll < 0 || m_wake < 0 || m_signals < 0 || listener < 0)
+		return false;
+	unlink(m_settings.path);
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+		::close(listener);
+		return false;
+	}
+	m_listener = listener;
+	watch(m_listener, EPOLLIN, EPOLL_CTL_ADD);
+	watch(m_wake, EPOLLIN, EPOLL_CTL_ADD);
+	watch(m_signals, EPOLLIN, EPOLL_CTL_ADD);
+	for (uint8_t i = 0; i < (m_settings.workers == 0 ? 1 : m_settings.workers); i++)
+		m_workers.emplace_back(&Loop::work, this);
+	return true;
+}
+void Loop::work() {
+	Engine::TranspositionTable table{m_settings.hash_megabytes};
+	while (true) {
+		SearchJob* job;
+		{
+			std::unique_lock<std::mutex> lock{m_mutex};
+			m_work.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+			if (m_stopping)
+				return;
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+		job->move = Engine::search(job->board, job->turn, table, m_limits).move;
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_done.push_back(job);
+		}
+		const uint64_t one = 1;
+		if (write(m_wake, &one, sizeof(one)) < 0)
+			continue; // the counter is only full after 2^64 - 1 searches nobody collected
+	}
+}
+void Loop::finish_searches() {
+	uint64_t count;
+	if (read(m_wake, &count, sizeof(count)) < 0)
+		return;
+	std::deque<SearchJob*> done;
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		done.swap(m_done);
+	}
+	for (SearchJob* job: done)
+		job->game.resume();
+}
+void Loop::accept_all() {
+	while (true) {
+		const int fd = accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		Connection* connection = new Connection(fd);
+		m_connections[fd]      = connection;
+		watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+		session(*this, *connection);
+	}
+}
+void Loop::receive(Connection& connection) {
+	char buffer[4096];
+	while (true) {
+		const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+		if (size > 0 && connection.input.size() + size <= max_line) {
+			connection.input.append(buffer, size);
+			continue;
+		}
+		if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (size < 0 && errno == EINTR)
+			continue;
+		// End of the input, an error or a line too long
+		connection.closed = true;
+		watch(connection.fd, 0, EPOLL_CTL_DEL);
+		break;
+	}
+	if (connection.closed) {
+		// A client waiting for an opponent has no coroutine to tell, it is dropped from the queue here
+		for (std::deque<Connection*>& waiting: m_waiting) {
+			for (auto i = waiting.begin(); i != waiting.end(); i++) {
+				if (*i == &connection) {
+					waiting.erase(i);
+					close(connection);
+					return;
+				}
+			}
+		}
+	}
+	if (connection.reader && (connection.closed || connection.input.find('\n') != std::string::npos)) {
+		const std::coroutine_handle<> reader = connection.reader;
+		connection.reader                    = nullptr;
+		reader.resume();
+	}
+}
+void Loop::flush(Connection& connection) {
+	while (!connection.closed && !connection.output.empty()) {
+		const ssize_t size = ::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+		if (size > 0) {
+			connection.output.erase(0, size);
+			continue;
+		}
+		if (size < 0 && errno == EINTR)
+			continue;
+		if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (!connection.writing)
+				watch(connection.fd, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+			connection.writing = true;
+			return;
+		}
+		connection.closed = true;
+		watch(connection.fd, 0, EPOLL_CTL_DEL);
+	}
+	if (connection.writing && !connection.closed)
+		watch(connection.fd, EPOLLIN, EPOLL_CTL_MOD);
+	connection.writing = false;
+}
+void Loop::send(Connection& connection, const std::string& text) {
+	if (connection.closed)
+		return;
+	connection.output += text;
+	if (!connection.writing)
+		flush(connection);
+}
+void Loop::close(Connection& connection) {
+	if (!connection.closed)
+		watch(connection.fd, 0, EPOLL_CTL_DEL);
+	connection.closed = true;
+	::close(connection.fd);
+	m_connections.erase(connection.fd);
+	m_closing.push_back(&connection);
+}
+void Loop::start(Connection& connection, Engine::Color color, Opponent opponent) {
+	const uint8_t side = static_cast<uint8_t>(color);
+	if (opponent == Opponent::human) {
+		if (m_waiting[1 - side].empty()) {
+			m_waiting[side].push_back(&connection);
+			send(connection, "waiting\n");
+			return;
+		}
+		Connection& other = *m_waiting[1 - side].front();
+		m_waiting[1 - side].pop_front();
+		Side sides[2];
+		sides[side]     = {std::make_unique<RemotePlayer>(*this, connection), &connection, Opponent::human};
+		sides[1 - side] = {std::make_unique<RemotePlayer>(*this, other), &other, Opponent::human};
+		play_game(*this, std::move(sides[0]), std::move(sides[1]));
+		return;
+	}
+	Side engine = {nullptr, nullptr, opponent};
+	if (opponent == Opponent::random)
+		engine.player = std::make_unique<RandomOpponent>(m_seed++);
+	else
+		engine.player = std::make_unique<SearchOpponent>(*this);
+	Side client = {std::make_unique<RemotePlayer>(*this, connection), &connection, Opponent::human};
+	if (color == Engine::Color::white)
+		play_game(*this, std::move(client), std::move(engine));
+	else
+		play_game(*this, std::move(engine), std::move(client));
+}
+std::string Loop::stats() const {
+	char line[128];
+	snprintf(line, sizeof(line), "stats games %u connections %lu frame-bytes %lu\n", m_games,
+	         static_cast<unsigned long>(m_connections.size()), static_cast<unsigned long>(frame_bytes));
+	return line;
+}
+int Loop::run() {
+	epoll_event events[256];
+	while (true) {
+		const int count = epoll_wait(m_epoll, events, 256, -1);
+		if (count < 0 && errno != EINTR)
+			return 1;
+		for (int i = 0; i < count; i++) {
+			const int fd = events[i].data.fd;
+			if (fd == m_signals)
+				return 0;
+			if (fd == m_listener)
+				accept_all();
+			else if (fd == m_wake)
+				finish_searches();
+			else {
+				// The connection may have been closed by a coroutine resumed earlier in this batch
+				const auto found = m_connections.find(fd);
+				if (found == m_connections.end())
+					continue;
+				Connection& connection = *found->second;
+				if (events[i].events & EPOLLOUT)
+					flush(connection);
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					receive(connection);
+			}
+		}
+		for (Connection* connection: m_closing)
+			delete connection;
+		m_closing.clear();
+	}
+}
+} // namespace
+int run(const Settings& settings) {
+	Loop loop{settings};
+	if (!loop.open()) {
+		fprintf(stderr, "cannot listen on %s: %s\n", settings.path, std::strerror(errno));
+		return 1;
+	}
+	return loop.run();
+}
+} // namespace Server
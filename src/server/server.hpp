@@ -0,0 +1,158 @@
+#pragma once
+#include "../engine/engine.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+namespace Server {
+// Bytes held by coroutine frames that are alive, every game is one frame plus one per pending move. The frames
+// are only created and destroyed on the thread of the event loop.
+inline size_t frame_bytes = 0;
+// Keeps the frames freed on a thread for the next frames of the same size class, every move of a game would
+// allocate a frame otherwise
+class FramePool {
+	static constexpr size_t granularity = 64;
+	static constexpr size_t classes     = 16; // frames above 1 KiB go straight to the heap
+	struct Free {
+		Free* next;
+	};
+	Free* m_free[classes]{};
+
+public:
+	FramePool() = default;
+	FramePool(const FramePool&) = delete;
+	inline ~FramePool() {
+		for (Free* list: m_free) {
+			while (list != nullptr) {
+				Free* const next = list->next;
+				::operator delete(list);
+				list = next;
+			}
+		}
+	}
+	inline void* allocate(size_t size) {
+		const size_t index = (size + granularity - 1) / granularity - 1;
+		if (index >= classes)
+			return ::operator new(size);
+		Free* const frame = m_free[index];
+		if (frame == nullptr)
+			return ::operator new((index + 1) * granularity);
+		m_free[index] = frame->next;
+		return frame;
+	}
+	inline void release(void* frame, size_t size) {
+		const size_t index = (size + granularity - 1) / granularity - 1;
+		if (index >= classes) {
+			::operator delete(frame);
+			return;
+		}
+		m_free[index] = new (frame) Free{m_free[index]};
+	}
+};
+inline thread_local FramePool frame_pool;
+// Promise base that counts the frame it lives in
+struct CountedPromise {
+	static void* operator new(size_t size) {
+		frame_bytes += size;
+		return frame_pool.allocate(size);
+	}
+	static void operator delete(void* frame, size_t size) {
+		frame_bytes -= size;
+		frame_pool.release(frame, size);
+	}
+	inline void unhandled_exception() {
+		std::terminate();
+	}
+};
+// Lazily started coroutine producing a T, the awaiting coroutine is resumed directly once it returns
+template <typename T>
+class Task {
+public:
+	struct promise_type : CountedPromise {
+		T                       value{};
+		std::coroutine_handle<> continuation{std::noop_coroutine()};
+		inline Task get_return_object() {
+			return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+		inline std::suspend_always initial_suspend() noexcept {
+			return {};
+		}
+		struct FinalAwaiter {
+			inline bool await_ready() noexcept {
+				return false;
+			}
+			inline std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+				return handle.promise().continuation;
+			}
+			inline void await_resume() noexcept {}
+		};
+		inline FinalAwaiter final_suspend() noexcept {
+			return {};
+		}
+		inline void return_value(T result) {
+			value = result;
+		}
+	};
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+	inline explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+public:
+	Task(const Task&) = delete;
+	inline Task(Task&& other) : m_handle(other.m_handle) {
+		other.m_handle = nullptr;
+	}
+	inline ~Task() {
+		if (m_handle)
+			m_handle.destroy();
+	}
+	inline bool await_ready() const {
+		return false;
+	}
+	inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+		m_handle.promise().continuation = awaiting;
+		return m_handle;
+	}
+	inline T await_resume() {
+		return m_handle.promise().value;
+	}
+};
+// Coroutine nobody awaits, it starts at once and frees itself when it finishes
+struct Detached {
+	struct promise_type : CountedPromise {
+		inline Detached get_return_object() {
+			return {};
+		}
+		inline std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+		inline std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+		inline void return_void() {}
+	};
+};
+// Non-blocking counterpart of Engine::Player: the game awaits the move, so a player waiting for a person or a
+// search suspends only its own game. Move{} resigns.
+class AsyncPlayer {
+public:
+	virtual inline ~AsyncPlayer() {}
+	virtual Task<Engine::Move> get_move(const Engine::Game& game) = 0;
+};
+struct Settings {
+	const char*          path{nullptr}; // Unix-domain socket the server listens on
+	uint8_t              workers{1};    // threads searching for the search opponents
+	Engine::SearchLimits limits{};      // of the search opponents
+	size_t               hash_megabytes{16};
+};
+// Hosts games between clients of a Unix-domain socket and the engine, all of them on one epoll loop with
+// searches handed to worker threads. Clients send lines:
+//   play <white|black> <random|search|human>   start a game, human waits for a client asking for the other colour
+//   stats                                      games, connections and coroutine frame bytes
+//   quit
+// and during a game a move in SAN, or resign, whenever the server sent `turn <fen>`. The server announces
+// `game <colour> <opponent>`, the moves of the opponent as `moved <san>`, and ends with `result <result> <reason>`.
+// Runs until SIGINT or SIGTERM, returns the exit code.
+int run(const Settings& settings);
+} // namespace Server
@@ -0,0 +1,260 @@
+#include "uci.hpp"
+#include <cstdlib>
+#include <cstring>
+namespace {
+constexpr const char* initial_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// Range of the Hash option in megabytes
+constexpr long max_hash = 65536;
+// Scores this close to search_mate are mates, found by the search or by a tablebase
+constexpr int16_t mate_bound = Engine::search_mate - Engine::mate_window;
+// Long algebraic notation: origin, destination and the promotion piece in lowercase, 0000 for no move
+char* write_move(Engine::Move move, char* text) {
+	constexpr char promotions[8] = {0, 'n', 'b', 'r', 'q', 0, 0, 0};
+	if (move == Engine::Move{})
+		return std::strcpy(text, "0000") + 4;
+	*text++                      = 'h' - move.from() % 8;
+	*text++                      = '8' - move.from() / 8;
+	*text++                      = 'h' - move.to() % 8;
+	*text++                      = '8' - move.to() / 8;
+	if (move.is_promotion())
+		*text++ = promotions[static_cast<uint8_t>(move.promotion())];
+	*text = '\0';
+	return text;
+}
+Engine::Move parse_move(const Engine::AvailableMoves& available, const char* text) {
+	char written[8];
+	for (Engine::Move move: available) {
+		write_move(move, written);
+		if (std::strcmp(written, text) == 0)
+			return move;
+	}
+	return Engine::Move{};
+}
+} // namespace
+namespace Uci {
+Protocol::Protocol(FILE* output) : m_output(output) {}
+Protocol::~Protocol() {
+	finish();
+}
+void Protocol::send(const char* line) {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	fputs(line, m_output);
+	fputc('\n', m_output);
+	fflush(m_output);
+}
+void Protocol::finish() {
+	if (!m_search.joinable())
+		return;
+	m_stop.store(true);
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_hold = false;
+	}
+	m_released.notify_all();
+	m_search.join();
+}
+void Protocol::set_option(char* arguments) {
+	// setoption name <name> value <value>, names may not contain spaces here
+	char*       state;
+	const char* keyword = strtok_r(arguments, " ", &state);
+	const char* name    = strtok_r(nullptr, " ", &state);
+	const char* marker  = strtok_r(nullptr, " ", &state);
+	const char* value   = strtok_r(nullptr, " ", &state);
+	if (keyword == nullptr || name == nullptr || marker == nullptr || value == nullptr
+	    || std::strcmp(keyword, "name") != 0 || std::strcmp(marker, "value") != 0)
+		return;
+	finish();
+	// Values out of the advertised range are clamped to it
+	const long number = std::strtol(value, nullptr, 10);
+	if (strcasecmp(name, "Hash") == 0 && number > 0 && !m_table.resize(number > max_hash ? max_hash : number))
+		send("info string cannot allocate the hash table, the previous one is kept");
+	else if (strcasecmp(name, "Threads") == 0 && number > 0)
+		m_threads = (number > 255 ? 255 : number);
+}
+void Protocol::position(char* arguments) {
+	finish();
+	char* moves = std::strstr(arguments, "moves");
+	if (moves != nullptr)
+		*moves++ = '\0';
+	const char* fen = initial_fen;
+	if (std::strncmp(arguments, "fen ", 4) == 0)
+		fen = arguments + 4;
+	else if (std::strncmp(arguments, "startpos", 8) != 0)
+		return;
+	// Built aside, a malformed command keeps the previous position
+	Engine::Board         board{};
+	Engine::Color         turn;
+	std::vector<uint64_t> history;
+	if (!board.set_fen(fen, turn))
+		return;
+	history.push_back(board.hash());
+	if (moves != nullptr) {
+		char* state;
+		for (char* text = strtok_r(moves + 4, " ", &state); text != nullptr; text = strtok_r(nullptr, " ", &state)) {
+			const Engine::Move move = parse_move(Engine::AvailableMoves{board, turn}, text);
+			if (move == Engine::Move{})
+				return;
+			// Positions before a capture or a pawn move cannot come back
+			if (move.is_capture(board) || Engine::piece_type(board.get_piece(move.from())) == Engine::PieceType::pawn)
+				history.clear();
+			board.make_move(move);
+			history.push_back(board.hash());
+			turn = (turn == Engine::Color::white ? Engine::Color::black : Engine::Color::white);
+		}
+	}
+	m_board.set_data(board.data(), turn);
+	m_turn = turn;
+	m_history.swap(history);
+}
+void Protocol::go(char* arguments) {
+	finish();
+	Engine::SearchLimits limits;
+	uint32_t             time[2]{}, increment[2]{}, moves_to_go = 0;
+	bool                 infinite = false, ponder = false;
+	char*                state;
+	for (char* token = strtok_r(arguments, " ", &state); token != nullptr; token = strtok_r(nullptr, " ", &state)) {
+		if (std::strcmp(token, "infinite") == 0) {
+			infinite = true;
+			continue;
+		}
+		if (std::strcmp(token, "ponder") == 0) {
+			ponder = true;
+			continue;
+		}
+		const char* value = strtok_r(nullptr, " ", &state);
+		if (value == nullptr)
+			break;
+		const uint64_t number = std::strtoull(value, nullptr, 10);
+		if (std::strcmp(token, "depth") == 0)
+			limits.depth = (number > 64 ? 64 : number);
+		else if (std::strcmp(token, "nodes") == 0)
+			limits.nodes = number;
+		else if (std::strcmp(token, "movetime") == 0)
+			limits.milliseconds = number;
+		else if (std::strcmp(token, "wtime") == 0)
+			time[0] = number;
+		else if (std::strcmp(token, "btime") == 0)
+			time[1] = number;
+		else if (std::strcmp(token, "winc") == 0)
+			increment[0] = number;
+		else if (std::strcmp(token, "binc") == 0)
+			increment[1] = number;
+		else if (std::strcmp(token, "movestogo") == 0)
+			moves_to_go = number;
+	}
+	// A share of the clock, keeping a margin for the time the answer takes to reach the GUI
+	const uint8_t side = static_cast<uint8_t>(m_turn);
+	if (limits.milliseconds == 0 && time[side] != 0 && !infinite) {
+		uint32_t budget = time[side] / (moves_to_go != 0 ? moves_to_go : 30) + increment[side] * 3 / 4;
+		const uint32_t margin = (time[side] > 100 ? 50 : time[side] / 2);
+		if (budget > time[side] - margin)
+			budget = time[side] - margin;
+		limits.milliseconds = (budget > 0 ? budget : 1);
+	}
+	limits.threads = m_threads;
+	limits.stop    = &m_stop;
+	limits.ponder  = &m_ponder;
+	limits.history = &m_history;
+	m_stop.store(false);
+	m_ponder.store(ponder);
+	m_hold = infinite || ponder;
+	m_search_board.set_data(m_board.data(), m_turn);
+	m_search_turn = m_turn;
+	m_search      = std::thread([this, limits]() {
+		const Engine::SearchInfo info = Engine::search(m_search_board, m_search_turn, m_table, limits, this);
+		{
+			std::unique_lock<std::mutex> lock{m_mutex};
+			m_released.wait(lock, [this]() { return !m_hold; });
+		}
+		char  line[64] = "bestmove ";
+		char* end      = write_move(info.move, line + 9);
+		// The move after ours from the table is the one worth pondering on
+		char pv[16];
+		if (principal_variation(info.move, 2, pv) - pv > 5)
+			std::strcat(std::strcpy(end, " ponder"), pv + 4);
+		send(line);
+	});
+}
+char* Protocol::principal_variation(Engine::Move first, uint8_t depth, char* text) {
+	Engine::Board copy{m_search_board};
+	Engine::Color turn = m_search_turn;
+	Engine::Move  move = first;
+	*text              = '\0';
+	for (uint8_t i = 0; i < depth && move != Engine::Move{}; i++) {
+		if (!Engine::AvailableMoves{copy, turn}.move_possible(move))
+			break;
+		if (i != 0)
+			*text++ = ' ';
+		text = write_move(move, text);
+		copy.make_move(move);
+		turn = (turn == Engine::Color::white ? Engine::Color::black : Engine::Color::white);
+		Engine::TranspositionTable::Entry entry;
+		move = (m_table.probe(copy.hash(), entry) ? Engine::Move::from_data(entry.move) : Engine::Move{});
+	}
+	return text;
+}
+void Protocol::iteration(const Engine::SearchInfo& info) {
+	char  line[1024];
+	char* text = line;
+	text += sprintf(text, "info depth %u score ", info.depth);
+	if (info.score >= mate_bound)
+		text += sprintf(text, "mate %d", (Engine::search_mate - info.score + 1) / 2);
+	else if (info.score <= -mate_bound)
+		text += sprintf(text, "mate %d", -(Engine::search_mate + info.score) / 2);
+	else
+		text += sprintf(text, "cp %d", info.score);
+	text += sprintf(text, " nodes %lu nps %lu time %u hashfull %u pv ", static_cast<unsigned long>(info.nodes),
+	                static_cast<unsigned long>(info.nodes * 1000 / (info.milliseconds > 0 ? info.milliseconds : 1)),
+	                info.milliseconds, m_table.permille_full());
+	principal_variation(info.move, info.depth < 100 ? info.depth : 100, text);
+	send(line);
+}
+int Protocol::run(FILE* input) {
+	char*  line     = nullptr;
+	size_t capacity = 0;
+	for (ssize_t length; (length = getline(&line, &capacity, input)) >= 0;) {
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+			line[--length] = '\0';
+		char* arguments = std::strchr(line, ' ');
+		if (arguments != nullptr)
+			*arguments++ = '\0';
+		else
+			arguments = line + length;
+		if (std::strcmp(line, "uci") == 0) {
+			send("id name CPPChess");
+			send("id author F100cTomas");
+			char option[64];
+			sprintf(option, "option name Hash type spin default 16 min 1 max %ld", max_hash);
+			send(option);
+			send("option name Threads type spin default 1 min 1 max 255");
+			send("option name Ponder type check default false");
+			send("uciok");
+		} else if (std::strcmp(line, "isready") == 0)
+			send("readyok");
+		else if (std::strcmp(line, "ucinewgame") == 0) {
+			finish();
+			m_table.clear();
+		} else if (std::strcmp(line, "setoption") == 0)
+			set_option(arguments);
+		else if (std::strcmp(line, "position") == 0)
+			position(arguments);
+		else if (std::strcmp(line, "go") == 0)
+			go(arguments);
+		else if (std::strcmp(line, "stop") == 0)
+			finish();
+		else if (std::strcmp(line, "ponderhit") == 0) {
+			// The search goes on under its own time limit, which counts from here
+			m_ponder.store(false);
+			{
+				std::lock_guard<std::mutex> lock{m_mutex};
+				m_hold = false;
+			}
+			m_released.notify_all();
+		} else if (std::strcmp(line, "quit") == 0)
+			break;
+	}
+	free(line);
+	finish();
+	return 0;
+}
+} // namespace Uci
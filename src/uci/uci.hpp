@@ -0,0 +1,47 @@
+#pragma once
+#include "../engine/engine.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+namespace Uci {
+// Universal Chess Interface over a pair of streams, commands are read on the calling thread while searches run
+// on a thread of their own so stop and isready are answered at once
+class Protocol : public Engine::SearchListener {
+	FILE*                      m_output;
+	Engine::TranspositionTable m_table{16};
+	Engine::Board              m_board{};
+	Engine::Color              m_turn{Engine::Color::white};
+	std::vector<uint64_t>      m_history{}; // hashes since the last capture or pawn move, the current position last
+	Engine::Board              m_search_board{}; // copy the running search works on
+	Engine::Color              m_search_turn{Engine::Color::white};
+	uint8_t                    m_threads{1};
+	std::thread                m_search{};
+	std::atomic<bool>          m_stop{false};
+	std::atomic<bool>          m_ponder{false};
+	std::mutex                 m_mutex; // guards the output and m_hold
+	std::condition_variable    m_released;
+	bool                       m_hold{false}; // bestmove waits for stop or ponderhit in infinite and ponder mode
+
+public:
+	explicit Protocol(FILE* output);
+	Protocol(const Protocol&) = delete;
+	~Protocol();
+
+private:
+	void send(const char* line);
+	// Stops the running search and waits until it has reported its move
+	void finish();
+	void set_option(char* arguments);
+	void position(char* arguments);
+	void go(char* arguments);
+	// Principal variation followed through the table, returns the end of the terminated text
+	char* principal_variation(Engine::Move first, uint8_t depth, char* text);
+
+public:
+	void iteration(const Engine::SearchInfo& info) override;
+	// Runs until quit or the end of the input, returns the exit code
+	int run(FILE* input);
+};
+} // namespace Uci
@@ -0,0 +1,294 @@
+#include "engine/engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+namespace {
+struct CorpusPosition {
+	const char* phase;
+	const char* fen;
+};
+// Fixed positions, so results of two builds measure the same work
+constexpr CorpusPosition corpus[] = {
+    {"opening", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {"opening", "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3"},
+    {"opening", "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5"},
+    {"opening", "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4"},
+    {"middlegame", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+    {"middlegame", "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8"},
+    {"middlegame", "2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1P2PN2/PB1NBPPP/2RQ1RK1 w - - 0 11"},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"endgame", "8/5pk1/6p1/8/3R4/6P1/5PK1/2r5 w - - 0 40"},
+    {"endgame", "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 50"},
+    {"endgame", "6k1/5p2/6p1/8/7P/6P1/1q3PK1/4Q3 b - - 0 45"},
+};
+constexpr const char* phases[3] = {"opening", "middlegame", "endgame"};
+// Checksums of every run are folded in here so the measured work cannot be optimised away
+volatile uint64_t sink = 0;
+struct Position {
+	Engine::Board             board;
+	Engine::Color             turn;
+	std::vector<Engine::Move> moves;
+	uint32_t                  packed[8]; // copy of the nibbles, as a stored position would be
+	Position(const Engine::Board& board, Engine::Color turn) : board(board), turn(turn) {
+		for (Engine::Move move: Engine::AvailableMoves{board, turn})
+			moves.push_back(move);
+		std::memcpy(packed, board.data(), sizeof(packed));
+	}
+};
+// Outputs of the batched kernels, sized for the largest phase before anything is timed
+std::vector<Engine::PackedBitboards> unpacked;
+std::vector<Engine::PieceCounts>     counted;
+// One run over the positions of a phase, returns the number of operations it did
+typedef uint64_t (*Benchmark)(std::vector<Position>& positions);
+uint64_t get_piece(std::vector<Position>& positions) {
+	uint64_t sum = 0;
+	for (const Position& position: positions) {
+		for (uint8_t i = 0; i < 64; i++)
+			sum += static_cast<uint8_t>(position.board.get_piece(i));
+	}
+	sink = sink + sum;
+	return positions.size() * 64;
+}
+// Every square is emptied and refilled, which leaves the board as it was
+uint64_t set_piece(std::vector<Position>& positions) {
+	for (Position& position: positions) {
+		for (uint8_t i = 0; i < 64; i++) {
+			const Engine::Piece piece = position.board.get_piece(i);
+			position.board.set_piece(i, Engine::Piece::empty);
+			position.board.set_piece(i, piece);
+		}
+		sink = sink + position.board.hash();
+	}
+	return positions.size() * 128;
+}
+uint64_t piece_color(std::vector<Position>& positions) {
+	uint64_t white = 0;
+	for (const Position& position: positions) {
+		for (uint8_t i = 0; i < 64; i++)
+			white += Engine::piece_color(position.board.get_piece(i)) == Engine::Color::white;
+	}
+	sink = sink + white;
+	return positions.size() * 64;
+}
+uint64_t make_move(std::vector<Position>& positions) {
+	uint64_t operations = 0;
+	for (Position& position: positions) {
+		for (Engine::Move move: position.moves) {
+			const Engine::Undo undo = position.board.make_move(move);
+			sink                    = sink + position.board.hash();
+			position.board.unmake_move(move, undo);
+		}
+		operations += position.moves.size();
+	}
+	return operations;
+}
+uint64_t available_moves(std::vector<Position>& positions) {
+	for (const Position& position: positions)
+		sink = sink + Engine::AvailableMoves{position.board, position.turn}.count();
+	return positions.size();
+}
+// Generation followed by a pass over every move, counted per move
+uint64_t iterate_moves(std::vector<Position>& positions) {
+	uint64_t operations = 0;
+	for (const Position& position: positions) {
+		uint64_t sum = 0;
+		for (Engine::Move move: Engine::AvailableMoves{position.board, position.turn})
+			sum += move.data();
+		sink = sink + sum;
+		operations += position.moves.size();
+	}
+	return operations;
+}
+// Rebuilding a board from stored nibbles, bitboards and hash included
+uint64_t set_data(std::vector<Position>& positions) {
+	for (Position& position: positions) {
+		position.board.set_data(position.packed, position.turn);
+		sink = sink + position.board.hash();
+	}
+	return positions.size();
+}
+uint64_t unpack_boards(std::vector<Position>& positions) {
+	Engine::unpack_boards(positions[0].packed, sizeof(Position), positions.size(), unpacked.data());
+	sink = sink + unpacked[0].types[0];
+	return positions.size();
+}
+uint64_t count_pieces(std::vector<Position>& positions) {
+	Engine::count_pieces(positions[0].packed, sizeof(Position), positions.size(), counted.data());
+	sink = sink + counted[0].pieces[0];
+	return positions.size();
+}
+struct Entry {
+	const char* name;
+	Benchmark   benchmark;
+};
+constexpr Entry benchmarks[] = {
+    {"get_piece", get_piece},
+    {"set_piece", set_piece},
+    {"piece_color", piece_color},
+    {"make_move", make_move},
+    {"available_moves", available_moves},
+    {"iterate_moves", iterate_moves},
+    {"set_data", set_data},
+    {"unpack_boards", unpack_boards},
+    {"count_pieces", count_pieces},
+};
+struct Result {
+	std::string name;
+	std::string phase;
+	double      median; // nanoseconds per operation
+	double      p99;
+	double      minimum;
+	uint64_t    operations; // per run
+};
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+// Warms up, then times samples of enough runs to last about the given duration each
+Result measure(const Entry& entry, const char* phase, std::vector<Position>& positions, uint32_t samples,
+               double sample_seconds) {
+	uint64_t   operations = 0;
+	uint64_t   runs       = 0;
+	const auto warm_up    = std::chrono::steady_clock::now();
+	while (runs == 0 || seconds_since(warm_up) < 0.05) {
+		operations = entry.benchmark(positions);
+		runs++;
+	}
+	const uint64_t      repeats = std::max<uint64_t>(1, runs * sample_seconds / seconds_since(warm_up));
+	std::vector<double> times;
+	for (uint32_t i = 0; i < samples; i++) {
+		const auto start = std::chrono::steady_clock::now();
+		for (uint64_t j = 0; j < repeats; j++)
+			entry.benchmark(positions);
+		times.push_back(seconds_since(start) * 1e9 / (repeats * operations));
+	}
+	std::sort(times.begin(), times.end());
+	const size_t p99 = std::min<size_t>(times.size() - 1, std::ceil(0.99 * times.size()) - 1);
+	return {entry.name, phase, times[times.size() / 2], times[p99], times[0], operations};
+}
+// Median of every benchmark in a file written by --output, keyed by benchmark and phase
+bool read_results(const char* path, std::vector<Result>& results) {
+	FILE* file = fopen(path, "r");
+	if (file == nullptr)
+		return false;
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		char          name[64], phase[64];
+		double        median, p99, minimum;
+		unsigned long operations;
+		if (line[0] != '#'
+		    && sscanf(line, "%63s %63s %lf %lf %lf %lu", name, phase, &median, &p99, &minimum, &operations) == 6)
+			results.push_back({name, phase, median, p99, minimum, operations});
+	}
+	fclose(file);
+	return true;
+}
+const char* build() {
+#if defined(PROFILE)
+	return "profile";
+#elif defined(ALLOCATION_AUDIT)
+	return "audit";
+#elif defined(DEBUG)
+	return "debug";
+#else
+	return "release";
+#endif
+}
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --samples <n>     timed samples of every benchmark, 51 by default\n"
+	        "  --sample-ms <n>   length of a sample, 5 by default\n"
+	        "  --filter <name>   run only the benchmarks with the text in their name\n"
+	        "  --output <file>   results as tab separated values, bench.tsv by default\n"
+	        "  --baseline <file> results of another build to compare the medians with\n"
+	        "  --scalar          packed board kernels without AVX2\n",
+	        program);
+}
+} // namespace
+int main(int argc, char** argv) {
+	uint32_t    samples   = 51;
+	double      sample_ms = 5;
+	const char* filter    = nullptr;
+	const char* output    = "bench.tsv";
+	const char* baseline  = nullptr;
+	bool        avx2      = true;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			samples = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--sample-ms") == 0 && i + 1 < argc)
+			sample_ms = std::max(0.1, std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baseline = argv[++i];
+		else if (std::strcmp(argv[i], "--scalar") == 0)
+			avx2 = false;
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	std::vector<Result> previous;
+	if (baseline != nullptr && !read_results(baseline, previous)) {
+		fprintf(stderr, "cannot read %s\n", baseline);
+		return 1;
+	}
+	std::vector<Position> positions[3];
+	for (const CorpusPosition& entry: corpus) {
+		Engine::Board board;
+		Engine::Color turn;
+		if (!board.set_fen(entry.fen, turn)) {
+			fprintf(stderr, "invalid FEN: %s\n", entry.fen);
+			return 1;
+		}
+		for (uint8_t i = 0; i < 3; i++) {
+			if (std::strcmp(entry.phase, phases[i]) == 0)
+				positions[i].emplace_back(board, turn);
+		}
+	}
+	for (const std::vector<Position>& phase: positions) {
+		unpacked.resize(std::max(unpacked.size(), phase.size()));
+		counted.resize(std::max(counted.size(), phase.size()));
+	}
+	avx2 = Engine::use_avx2(avx2);
+	printf("%s build, %s kernels, %u samples of %.1f ms\n", build(), avx2 ? "AVX2" : "scalar", samples, sample_ms);
+	printf("%-16s %-11s %10s %10s %10s %10s\n", "benchmark", "phase", "median ns", "p99 ns", "min ns",
+	       baseline != nullptr ? "change" : "");
+	std::vector<Result> results;
+	for (const Entry& entry: benchmarks) {
+		if (filter != nullptr && std::strstr(entry.name, filter) == nullptr)
+			continue;
+		for (uint8_t i = 0; i < 3; i++) {
+			const Result result = measure(entry, phases[i], positions[i], samples, sample_ms / 1000);
+			printf("%-16s %-11s %10.2f %10.2f %10.2f", result.name.c_str(), result.phase.c_str(), result.median,
+			       result.p99, result.minimum);
+			for (const Result& old: previous) {
+				if (old.name == result.name && old.phase == result.phase && old.median > 0)
+					printf(" %+9.1f%%", (result.median / old.median - 1) * 100);
+			}
+			printf("\n");
+			results.push_back(result);
+		}
+	}
+	FILE* file = fopen(output, "w");
+	if (file == nullptr) {
+		fprintf(stderr, "cannot write %s\n", output);
+		return 1;
+	}
+	fprintf(file, "# %s build, %s kernels, nanoseconds per operation\n# benchmark\tphase\tmedian\tp99\tmin\toperations\n",
+	        build(), avx2 ? "AVX2" : "scalar");
+	for (const Result& result: results)
+		fprintf(file, "%s\t%s\t%.3f\t%.3f\t%.3f\t%lu\n", result.name.c_str(), result.phase.c_str(), result.median,
+		        result.p99, result.minimum, static_cast<unsigned long>(result.operations));
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "engine/engine.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+namespace {
+struct BookMove {
+	uint64_t key;
+	uint16_t move;
+	inline bool operator<(const BookMove& other) const {
+		return key != other.key ? key < other.key : move < other.move;
+	}
+};
+// Collects the moves of the first plies of every game, one per reading thread
+class BookVisitor : public Engine::PgnVisitor {
+	uint16_t m_plies;
+	uint16_t m_ply{0};
+
+public:
+	std::vector<BookMove> moves{};
+
+public:
+	explicit BookVisitor(uint16_t plies) : m_plies(plies) {}
+	void move(const Engine::Board& board, Engine::Color turn, Engine::Move move) override {
+		if (m_ply++ < m_plies)
+			moves.push_back({Engine::polyglot_key(board, turn), Engine::polyglot_move(board, move)});
+	}
+	void end_game(Engine::GameResult result, bool legal) override {
+		m_ply = 0;
+	}
+};
+// Keys listed by the Polyglot specification, from the start position through 1. e4 d5 2. e5 f5 3. Ke2 Kf7
+struct ReferenceKey {
+	const char* fen;
+	uint64_t    key;
+};
+constexpr ReferenceKey reference_keys[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463B96181691FC9CULL},
+    {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+    {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0ULL},
+    {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL}, // e5 can take on f6
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652A607CA3F242C1ULL},
+    {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9ULL},
+};
+// Books written with wrong keys would only ever be read back by this engine, so they are not written at all
+bool check_keys() {
+	for (const ReferenceKey& reference: reference_keys) {
+		Engine::Board board{};
+		Engine::Color turn;
+		if (!board.set_fen(reference.fen, turn) || Engine::polyglot_key(board, turn) != reference.key) {
+			fprintf(stderr, "wrong Polyglot key of %s\n", reference.fen);
+			return false;
+		}
+	}
+	return true;
+}
+void write_big_endian(uint64_t value, uint8_t length, unsigned char* bytes) {
+	for (uint8_t i = length; i-- > 0; value >>= 8)
+		bytes[i] = value & 0xFF;
+}
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s <file.pgn> <file.bin> [options]\n"
+	        "  --plies <n>     moves taken from the start of every game, 16 by default\n"
+	        "  --min <n>       moves played fewer times are left out, 1 by default\n"
+	        "  --threads <n>   threads replaying the file, all cores by default\n",
+	        program);
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char* paths[2] = {nullptr, nullptr};
+	uint16_t    plies    = 16;
+	uint32_t    minimum  = 1;
+	uint8_t     threads  = std::thread::hardware_concurrency();
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--plies") == 0 && i + 1 < argc)
+			plies = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--min") == 0 && i + 1 < argc)
+			minimum = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if (argv[i][0] != '-' && paths[1] == nullptr)
+			paths[paths[0] == nullptr ? 0 : 1] = argv[i];
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (paths[1] == nullptr) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (threads == 0)
+		threads = 1;
+	if (!check_keys())
+		return 1;
+	Engine::PgnFile file;
+	if (!file.open(paths[0])) {
+		fprintf(stderr, "cannot read %s\n", paths[0]);
+		return 1;
+	}
+	std::vector<BookVisitor>         visitors(threads, BookVisitor(plies));
+	std::vector<Engine::PgnVisitor*> pointers;
+	for (BookVisitor& visitor: visitors)
+		pointers.push_back(&visitor);
+	const Engine::PgnStats stats = file.replay(pointers.data(), threads);
+	std::vector<BookMove>  moves;
+	for (const BookVisitor& visitor: visitors)
+		moves.insert(moves.end(), visitor.moves.begin(), visitor.moves.end());
+	std::sort(moves.begin(), moves.end());
+	FILE* output = fopen(paths[1], "wb");
+	if (output == nullptr) {
+		fprintf(stderr, "cannot write %s\n", paths[1]);
+		return 1;
+	}
+	// Every distinct move becomes one entry weighted by how often it was played
+	size_t entries = 0;
+	for (size_t i = 0, next; i < moves.size(); i = next) {
+		for (next = i + 1; next < moves.size() && moves[next].key == moves[i].key && moves[next].move == moves[i].move;)
+			next++;
+		if (next - i < minimum)
+			continue;
+		unsigned char entry[16]{};
+		write_big_endian(moves[i].key, 8, entry);
+		write_big_endian(moves[i].move, 2, entry + 8);
+		write_big_endian(std::min<size_t>(next - i, 0xFFFF), 2, entry + 10);
+		fwrite(entry, 1, sizeof(entry), output);
+		entries++;
+	}
+	fclose(output);
+	printf("games %lu errors %lu moves %lu entries %lu\n", static_cast<unsigned long>(stats.games),
+	       static_cast<unsigned long>(stats.errors), static_cast<unsigned long>(moves.size()),
+	       static_cast<unsigned long>(entries));
+	return 0;
+}
@@ -0,0 +1,194 @@
+#include "engine/engine.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+namespace {
+struct PerftPosition {
+	const char* name;
+	const char* fen;
+	uint64_t    nodes[7]; // expected node counts from depth 1, zero when not listed
+	uint8_t     depth;    // depth searched by the default suite
+};
+// Reference positions and node counts from the Chess Programming Wiki
+constexpr PerftPosition suite[] = {
+    {"initial", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 119060324, 3195901860}, 5},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690, 8031647685, 0}, 4},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", {14, 191, 2812, 43238, 674624, 11030083, 178633661}, 5},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292, 706045033, 0}, 4},
+    {"promotions mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+     {6, 264, 9467, 422333, 15833292, 706045033, 0}, 4},
+    {"discovered", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 89941194, 0, 0}, 4},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 164075551, 6923051137, 0}, 4},
+};
+Engine::Color opponent(Engine::Color color) {
+	return color == Engine::Color::white ? Engine::Color::black : Engine::Color::white;
+}
+uint64_t perft(Engine::Board& board, Engine::Color turn, uint8_t depth, bool bulk) {
+	const Engine::AvailableMoves available{board, turn};
+	if (bulk && depth == 1)
+		return available.count();
+	uint64_t nodes = 0;
+	for (Engine::Move move: available) {
+		if (depth == 1) {
+			nodes++;
+			continue;
+		}
+		const Engine::Undo undo = board.make_move(move);
+		nodes += perft(board, opponent(turn), depth - 1, bulk);
+		board.unmake_move(move, undo);
+	}
+	return nodes;
+}
+// Coordinate notation with the promotion piece appended
+void print_move(Engine::Move move, uint64_t nodes) {
+	constexpr char promotions[8] = {0, 'n', 'b', 'r', 'q', 0, 0, 0};
+	const char     promotion[2]  = {promotions[static_cast<uint8_t>(move.promotion())], 0};
+	printf("%c%c%c%c%s: %lu\n", 'h' - move.from() % 8, '8' - move.from() / 8, 'h' - move.to() % 8, '8' - move.to() / 8,
+	       promotion, static_cast<unsigned long>(nodes));
+}
+void divide(Engine::Board& board, Engine::Color turn, uint8_t depth, bool bulk) {
+	uint64_t total = 0;
+	for (Engine::Move move: Engine::AvailableMoves{board, turn}) {
+		const Engine::Undo undo  = board.make_move(move);
+		const uint64_t     nodes = (depth <= 1 ? 1 : perft(board, opponent(turn), depth - 1, bulk));
+		board.unmake_move(move, undo);
+		print_move(move, nodes);
+		total += nodes;
+	}
+	printf("\nnodes: %lu\n", static_cast<unsigned long>(total));
+}
+// Counts a single position and prints throughput, returns false when the count differs from the expected one
+bool run(const char* name, const char* fen, uint8_t depth, uint64_t expected, bool bulk, uint64_t& total) {
+	Engine::Board board{};
+	Engine::Color turn;
+	if (!board.set_fen(fen, turn)) {
+		printf("%-20s invalid FEN: %s\n", name, fen);
+		return false;
+	}
+	const auto     start   = std::chrono::steady_clock::now();
+	const uint64_t nodes   = perft(board, turn, depth, bulk);
+	total += nodes;
+	const double   seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const bool     passed  = expected == 0 || nodes == expected;
+	printf("%-20s depth %u %12lu nodes %8.3f s %12.0f nodes/s %s\n", name, depth, static_cast<unsigned long>(nodes),
+	       seconds, nodes / (seconds > 0 ? seconds : 1e-9), expected == 0 ? "" : passed ? "ok" : "FAILED");
+	return passed;
+}
+// Expected count of a depth from the `D<depth> <nodes>` operations of a perft suite, zero when not listed
+uint64_t expected_nodes(const char* operations, uint16_t length, uint8_t depth) {
+	for (uint16_t i = 0; i + 1 < length; i++) {
+		if (operations[i] != 'D' || (i > 0 && operations[i - 1] != ';' && operations[i - 1] != ' '))
+			continue;
+		char*               end;
+		const unsigned long listed = std::strtoul(operations + i + 1, &end, 10);
+		if (listed == depth && end < operations + length && *end == ' ')
+			return std::strtoull(end, nullptr, 10);
+	}
+	return 0;
+}
+// Counts every position of an EPD perft suite to every listed depth up to max_depth
+bool run_epd(const char* path, uint8_t max_depth, bool bulk) {
+	Engine::EpdFile file;
+	const auto      start = std::chrono::steady_clock::now();
+	if (!file.open(path, std::thread::hardware_concurrency())) {
+		fprintf(stderr, "cannot read %s\n", path);
+		return false;
+	}
+	const double loaded = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("loaded %lu positions in %.3f s, %lu rejected\n", static_cast<unsigned long>(file.size()), loaded,
+	       static_cast<unsigned long>(file.rejected()));
+	bool     passed = true;
+	uint64_t total  = 0;
+	for (size_t i = 0; i < file.size(); i++) {
+		for (uint8_t depth = 1; depth <= max_depth; depth++) {
+			const uint64_t expected = expected_nodes(file.operations(i), file[i].length, depth);
+			if (expected == 0)
+				continue;
+			Engine::Board board{};
+			file.get_board(i, board);
+			const uint64_t nodes = perft(board, file[i].turn, depth, bulk);
+			total += nodes;
+			if (nodes != expected) {
+				char fen[Engine::fen_size];
+				board.get_fen(file[i].turn, fen);
+				printf("%s depth %u: %lu nodes, expected %lu FAILED\n", fen, depth, static_cast<unsigned long>(nodes),
+				       static_cast<unsigned long>(expected));
+				passed = false;
+			}
+		}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - loaded;
+	printf("total %lu nodes %.3f s %.0f nodes/s %s\n", static_cast<unsigned long>(total), seconds, total / seconds,
+	       passed ? "ok" : "FAILED");
+	return passed;
+}
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --fen <fen>     position to count instead of the built-in suite\n"
+	        "  --epd <file>    suite with `D<depth> <nodes>` operations to count instead, up to depth 4 by default\n"
+	        "  --depth <n>     depth to count, overrides the suite depths\n"
+	        "  --divide        print the node count below every root move\n"
+	        "  --no-bulk       generate and play the leaf moves instead of counting them\n",
+	        program);
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char* fen   = nullptr;
+	const char* epd   = nullptr;
+	uint8_t     depth = 0;
+	bool        split = false;
+	bool        bulk  = true;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--fen") == 0 && i + 1 < argc)
+			fen = argv[++i];
+		else if (std::strcmp(argv[i], "--epd") == 0 && i + 1 < argc)
+			epd = argv[++i];
+		else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--divide") == 0)
+			split = true;
+		else if (std::strcmp(argv[i], "--no-bulk") == 0)
+			bulk = false;
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (epd != nullptr)
+		return run_epd(epd, depth == 0 ? 4 : depth, bulk) ? 0 : 1;
+	uint64_t nodes = 0;
+	if (fen != nullptr) {
+		if (depth == 0)
+			depth = 1;
+		if (!split)
+			return run("position", fen, depth, 0, bulk, nodes) ? 0 : 1;
+		Engine::Board board{};
+		Engine::Color turn;
+		if (!board.set_fen(fen, turn)) {
+			fprintf(stderr, "invalid FEN: %s\n", fen);
+			return 1;
+		}
+		divide(board, turn, depth, bulk);
+		return 0;
+	}
+	bool       passed = true;
+	const auto start  = std::chrono::steady_clock::now();
+	for (const PerftPosition& position: suite) {
+		const uint8_t  used     = (depth == 0 ? position.depth : depth);
+		const uint64_t expected = (used >= 1 && used <= 7 ? position.nodes[used - 1] : 0);
+		passed &= run(position.name, position.fen, used, expected, bulk, nodes);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("total %lu nodes %.3f s %.0f nodes/s %s\n", static_cast<unsigned long>(nodes), seconds, nodes / seconds,
+	       passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include "engine/engine.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+namespace {
+// Counts results and optionally keeps every position reached, one per reading thread
+class StatsVisitor : public Engine::PgnVisitor {
+	bool m_positions;
+
+public:
+	uint64_t          results[4]{}; // indexed by GameResult
+	std::vector<char> epd{};
+
+public:
+	explicit StatsVisitor(bool positions) : m_positions(positions) {}
+	void move(const Engine::Board& board, Engine::Color turn, Engine::Move move) override {
+		if (!m_positions)
+			return;
+		char       fen[Engine::fen_size];
+		const auto end = board.get_fen(turn, fen);
+		*end           = '\n';
+		epd.insert(epd.end(), fen, end + 1);
+	}
+	void end_game(Engine::GameResult result, bool legal) override {
+		results[static_cast<uint8_t>(result)]++;
+	}
+};
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s <file.pgn> [options]\n"
+	        "  --threads <n>   threads replaying the file, all cores by default\n"
+	        "  --epd <file>    write the position before every move as EPD\n",
+	        program);
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char* path    = nullptr;
+	const char* epd     = nullptr;
+	uint8_t     threads = std::thread::hardware_concurrency();
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--epd") == 0 && i + 1 < argc)
+			epd = argv[++i];
+		else if (path == nullptr && argv[i][0] != '-')
+			path = argv[i];
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (path == nullptr) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (threads == 0)
+		threads = 1;
+	Engine::PgnFile file;
+	if (!file.open(path)) {
+		fprintf(stderr, "cannot read %s\n", path);
+		return 1;
+	}
+	std::vector<StatsVisitor>         visitors(threads, StatsVisitor(epd != nullptr));
+	std::vector<Engine::PgnVisitor*> pointers;
+	for (StatsVisitor& visitor: visitors)
+		pointers.push_back(&visitor);
+	const Engine::PgnStats stats   = file.replay(pointers.data(), threads);
+	const double           seconds = (stats.milliseconds > 0 ? stats.milliseconds : 1) / 1000.0;
+	uint64_t               results[4]{};
+	for (const StatsVisitor& visitor: visitors) {
+		for (uint8_t i = 0; i < 4; i++)
+			results[i] += visitor.results[i];
+	}
+	printf("games %lu plies %lu errors %lu time %.3f s\n", static_cast<unsigned long>(stats.games),
+	       static_cast<unsigned long>(stats.plies), static_cast<unsigned long>(stats.errors), seconds);
+	printf("%.0f games/s %.0f plies/s\n", stats.games / seconds, stats.plies / seconds);
+	printf("1-0 %lu 0-1 %lu 1/2-1/2 %lu * %lu\n",
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::white_wins)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::black_wins)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::draw)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::unknown)]));
+	if (epd != nullptr) {
+		FILE* output = fopen(epd, "w");
+		if (output == nullptr) {
+			fprintf(stderr, "cannot write %s\n", epd);
+			return 1;
+		}
+		for (const StatsVisitor& visitor: visitors)
+			fwrite(visitor.epd.data(), 1, visitor.epd.size(), output);
+		fclose(output);
+	}
+	return stats.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "engine/engine.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+namespace {
+const char* result_text(Engine::GameResult result) {
+	switch (result) {
+	case Engine::GameResult::white_wins: return "1-0";
+	case Engine::GameResult::black_wins: return "0-1";
+	case Engine::GameResult::draw: return "1/2-1/2";
+	case Engine::GameResult::unknown: break;
+	}
+	return "*";
+}
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s <file> [options]\n"
+	        "  --max-pieces <n>  keep only the positions with at most n pieces, kings included\n"
+	        "  --output <file>   write the kept records to another record file\n"
+	        "  --block <n>       records per compressed block of the output, 0 stores them uncompressed, %u by default\n"
+	        "  --sample <n>      print n records drawn in shuffled order as FEN, score, move and result\n"
+	        "  --seed <n>        seed of the shuffle, 0 by default\n",
+	        program, Engine::record_block_size);
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char* path       = nullptr;
+	const char* output     = nullptr;
+	uint32_t    block_size = Engine::record_block_size;
+	uint8_t     max_pieces = 32;
+	size_t      samples    = 0;
+	uint64_t    seed       = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--max-pieces") == 0 && i + 1 < argc)
+			max_pieces = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+			block_size = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--sample") == 0 && i + 1 < argc)
+			samples = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (path == nullptr && argv[i][0] != '-')
+			path = argv[i];
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (path == nullptr) {
+		usage(argv[0]);
+		return 2;
+	}
+	Engine::RecordFile file;
+	if (!file.open(path)) {
+		fprintf(stderr, "cannot read %s\n", path);
+		return 1;
+	}
+	Engine::RecordWriter writer;
+	if (output != nullptr && !writer.open(output, block_size)) {
+		fprintf(stderr, "cannot write %s\n", output);
+		return 1;
+	}
+	// Blocks are scanned whole, the piece counts of a block come from one batched call
+	const auto                          start = std::chrono::steady_clock::now();
+	std::vector<Engine::PieceCounts>    counts;
+	std::vector<Engine::PositionRecord> kept;
+	uint64_t                            results[4]{};
+	uint64_t                            total = 0, corrupt = 0, invalid = 0;
+	for (size_t i = 0; i < file.blocks(); i++) {
+		size_t                              count;
+		const Engine::PositionRecord* const records = file.block(i, count);
+		if (records == nullptr) {
+			corrupt++;
+			continue;
+		}
+		counts.resize(count);
+		Engine::count_pieces(records[0].board, sizeof(Engine::PositionRecord), count, counts.data());
+		kept.clear();
+		for (size_t j = 0; j < count; j++) {
+			// Records with a result outside the enum come from a damaged file and are left out
+			if (records[j].result > Engine::GameResult::draw) {
+				invalid++;
+				continue;
+			}
+			const uint8_t* pieces = counts[j].pieces;
+			const uint8_t  empty  = pieces[static_cast<uint8_t>(Engine::Piece::empty)]
+			                      + pieces[static_cast<uint8_t>(Engine::Piece::en_passant)];
+			if (64 - empty > max_pieces)
+				continue;
+			results[static_cast<uint8_t>(records[j].result)]++;
+			kept.push_back(records[j]);
+		}
+		total += kept.size();
+		writer.write(kept.data(), kept.size());
+	}
+	const bool written = writer.close();
+	if (!written)
+		fprintf(stderr, "cannot write all records to %s\n", output);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("records %lu kept %lu invalid %lu %s blocks %lu corrupt %lu time %.3f s\n",
+	       static_cast<unsigned long>(file.size()), static_cast<unsigned long>(total), static_cast<unsigned long>(invalid),
+	       file.compressed() ? "compressed" : "uncompressed", static_cast<unsigned long>(file.blocks()),
+	       static_cast<unsigned long>(corrupt), seconds);
+	printf("%.0f records/s\n", file.size() / (seconds > 0 ? seconds : 1e-9));
+	printf("1-0 %lu 0-1 %lu 1/2-1/2 %lu * %lu\n",
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::white_wins)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::black_wins)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::draw)]),
+	       static_cast<unsigned long>(results[static_cast<uint8_t>(Engine::GameResult::unknown)]));
+	if (samples == 0)
+		return corrupt == 0 && invalid == 0 && written ? 0 : 1;
+	std::vector<size_t> order;
+	file.shuffle(seed, order);
+	for (size_t i = 0; i < samples && i < order.size(); i++) {
+		Engine::PositionRecord record;
+		if (!file.read(order[i], record))
+			continue;
+		Engine::Board board;
+		board.set_data(record.board, record.turn);
+		char fen[Engine::fen_size], san[16];
+		board.get_fen(record.turn, fen);
+		*Engine::write_san(board, record.turn, Engine::Move::from_data(record.move), san) = '\0';
+		printf("%s; ply %u score %d move %s result %s\n", fen, record.ply, record.score, san, result_text(record.result));
+	}
+	return corrupt == 0 && invalid == 0 && written ? 0 : 1;
+}
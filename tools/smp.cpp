@@ -0,0 +1,98 @@
+#include "engine/engine.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+namespace {
+struct SmpPosition {
+	const char* name;
+	const char* fen;
+};
+constexpr SmpPosition suite[] = {
+    {"initial", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+};
+double per_second(uint64_t nodes, uint32_t milliseconds) {
+	return nodes * 1000.0 / (milliseconds > 0 ? milliseconds : 1);
+}
+// Searches the position to a fixed depth with a cleared table so every run starts from the same state
+Engine::SearchInfo run(const char* fen, uint8_t depth, uint8_t threads, size_t hash_megabytes) {
+	Engine::Board board{};
+	Engine::Color turn;
+	board.set_fen(fen, turn);
+	Engine::TranspositionTable table{hash_megabytes};
+	Engine::SearchLimits       limits;
+	limits.depth   = depth;
+	limits.threads = threads;
+	return Engine::search(board, turn, table, limits);
+}
+void report(const char* name, uint8_t threads, const Engine::SearchInfo& info) {
+	printf("%-12s %3u threads depth %2u %12lu nodes %8u ms %12.0f nodes/s\n", name, threads, info.depth,
+	       static_cast<unsigned long>(info.nodes), info.milliseconds, per_second(info.nodes, info.milliseconds));
+	for (size_t i = 0; i < info.thread_nodes.size() && threads > 1; i++)
+		printf("  thread %3lu %12lu nodes %12.0f nodes/s\n", static_cast<unsigned long>(i),
+		       static_cast<unsigned long>(info.thread_nodes[i]), per_second(info.thread_nodes[i], info.milliseconds));
+}
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "  --fen <fen>     position to search instead of the built-in suite\n"
+	        "  --depth <n>     depth every search runs to, 10 by default\n"
+	        "  --threads <n>   threads compared against one, all cores by default\n"
+	        "  --hash <mb>     size of the shared table, 64 by default\n",
+	        program);
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char* fen     = nullptr;
+	uint8_t     depth   = 10;
+	uint8_t     threads = std::thread::hardware_concurrency();
+	size_t      hash    = 64;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--fen") == 0 && i + 1 < argc)
+			fen = argv[++i];
+		else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+			hash = std::atoi(argv[++i]);
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (threads == 0)
+		threads = 1;
+	const SmpPosition  single[] = {{"position", fen}};
+	const SmpPosition* begin    = (fen != nullptr ? single : suite);
+	const SmpPosition* end      = (fen != nullptr ? single + 1 : suite + sizeof(suite) / sizeof(suite[0]));
+	// Lazy SMP searches more nodes to the same depth, so time to depth is the speedup that matters
+	uint32_t one_time = 0, many_time = 0;
+	uint64_t one_nodes = 0, many_nodes = 0;
+	for (const SmpPosition* position = begin; position != end; position++) {
+		Engine::Board board{};
+		Engine::Color turn;
+		if (!board.set_fen(position->fen, turn)) {
+			fprintf(stderr, "invalid FEN: %s\n", position->fen);
+			return 1;
+		}
+		const Engine::SearchInfo one  = run(position->fen, depth, 1, hash);
+		const Engine::SearchInfo many = run(position->fen, depth, threads, hash);
+		report(position->name, 1, one);
+		report(position->name, threads, many);
+		one_time += one.milliseconds;
+		many_time += many.milliseconds;
+		one_nodes += one.nodes;
+		many_nodes += many.nodes;
+	}
+	printf("\n1 thread %12.0f nodes/s, %u threads %12.0f nodes/s\n", per_second(one_nodes, one_time), threads,
+	       per_second(many_nodes, many_time));
+	printf("speedup: %.2fx nodes/s, %.2fx time to depth %u\n",
+	       per_second(many_nodes, many_time) / per_second(one_nodes, one_time),
+	       static_cast<double>(one_time > 0 ? one_time : 1) / (many_time > 0 ? many_time : 1), depth);
+	return 0;
+}
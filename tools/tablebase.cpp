@@ -0,0 +1,93 @@
+#include "engine/engine.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+namespace {
+void usage(const char* program) {
+	fprintf(stderr,
+	        "usage: %s <directory> [material...] [options]\n"
+	        "solves every material such as KQvK or KPvK into the directory, with the tables it leads to\n"
+	        "  --threads <n>   threads solving a table, all cores by default\n"
+	        "  --probe <fen>   print the value of the position and of every move from it\n",
+	        program);
+}
+void print_entry(const Engine::TablebaseEntry& entry) {
+	if (entry.wdl == 0)
+		printf("draw");
+	else
+		printf("%s in %u plies", entry.wdl > 0 ? "win" : "loss", entry.plies);
+}
+int probe(const Engine::Tablebases& tablebases, const char* fen) {
+	Engine::Board board;
+	Engine::Color turn;
+	if (!board.set_fen(fen, turn)) {
+		fprintf(stderr, "malformed FEN %s\n", fen);
+		return 2;
+	}
+	Engine::TablebaseEntry entry;
+	if (!tablebases.probe(board, turn, entry)) {
+		printf("not in the tablebases\n");
+		return 1;
+	}
+	print_entry(entry);
+	printf("\n");
+	const Engine::Color opponent = (turn == Engine::Color::white ? Engine::Color::black : Engine::Color::white);
+	for (Engine::Move move: Engine::AvailableMoves{board, turn}) {
+		char san[16];
+		Engine::write_san(board, turn, move, san);
+		Engine::Board child{board};
+		child.make_move(move);
+		printf("%-8s ", san);
+		if (Engine::bit_count(child.occupied()) == 2)
+			printf("draw\n");
+		else if (tablebases.probe(child, opponent, entry)) {
+			print_entry(entry);
+			printf("\n");
+		} else
+			printf("?\n");
+	}
+	return 0;
+}
+} // namespace
+int main(int argc, char** argv) {
+	const char*              directory = nullptr;
+	const char*              fen       = nullptr;
+	std::vector<const char*> materials;
+	uint8_t                  threads = std::thread::hardware_concurrency();
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--probe") == 0 && i + 1 < argc)
+			fen = argv[++i];
+		else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 2;
+		} else if (directory == nullptr)
+			directory = argv[i];
+		else
+			materials.push_back(argv[i]);
+	}
+	if (directory == nullptr) {
+		usage(argv[0]);
+		return 2;
+	}
+	Engine::Tablebases tablebases;
+	if (!tablebases.open(directory)) {
+		fprintf(stderr, "cannot read %s\n", directory);
+		return 1;
+	}
+	for (const char* material: materials) {
+		const auto start = std::chrono::steady_clock::now();
+		if (!tablebases.generate(material, directory, threads)) {
+			fprintf(stderr, "cannot solve %s\n", material);
+			return 1;
+		}
+		printf("%s solved in %.3f s\n", material,
+		       std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return fen != nullptr ? probe(tablebases, fen) : 0;
+}